@@ -19,30 +19,54 @@ LOCAL_PRELINK_MODULE := false
 LOCAL_SRC_FILES := \
 	cyanogen-dsp.cpp \
 	Biquad.cpp \
+	BiquadBank.cpp \
+	CoefficientCache.cpp \
+	Convolver.cpp \
+	Cpu.cpp \
+	Crossover.cpp \
 	Delay.cpp \
+	Designer.cpp \
 	Effect.cpp \
 	EffectBassBoost.cpp \
+	EffectChain.cpp \
 	EffectCompression.cpp \
 	EffectEqualizer.cpp \
+	EffectLimiter.cpp \
+	EffectStats.cpp \
+	EffectTrace.cpp \
 	EffectVirtualizer.cpp \
-	FIR16.cpp
+	FFT.cpp \
+	FIR16.cpp \
+	Hrtf.cpp \
+	LevelDetector.cpp \
+	Pcm.cpp \
+	SlidingMax.cpp
 
 LOCAL_SHARED_LIBRARIES := \
 	libcutils \
-	liblog
+	liblog \
+	libutils
 
-include $(BUILD_SHARED_LIBRARY)
+# No instruction set flags: the kernels are built for the target's own
+# baseline (NEON on armv7-a-neon and arm64) and, on x86, also for AVX2
+# and AVX-512, picked at run time. See Cpu.h.
 
-ifneq ($(TARGET_USE_DEVICE_AUDIO_EFFECTS_CONF),true)
-include $(CLEAR_VARS)
+# Integer DSP engine for SoCs with slow double precision floating point.
+# Set TARGET_DSP_FIXED_POINT := true in the device BoardConfig.mk.
+ifeq ($(TARGET_DSP_FIXED_POINT),true)
+LOCAL_CFLAGS += -DDSP_FIXED_POINT
+endif
 
-ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
-LOCAL_CPPFLAGS := -D__cpusplus -g -mfloat-abi=softfp -ffunction-sections -fdata-sections -Ofast -ftree-vectorize -mfpu=neon -march=armv7-a -DHAVE_NEON=1 -DNDEBUG
+# Moves the equalizer's periodic filter redesign from the audio callback
+# to a shared background thread. Set TARGET_DSP_DESIGNER_THREAD := true.
+ifeq ($(TARGET_DSP_DESIGNER_THREAD),true)
+LOCAL_CFLAGS += -DDSP_DESIGNER_THREAD
 endif
 
-# LOCAL_CPPFLAGS += -DNDEBUG
+include $(BUILD_SHARED_LIBRARY)
 
-# -ffunction-sections -fdata-sections -Ofast -ftree-vectorize
+ifneq ($(TARGET_USE_DEVICE_AUDIO_EFFECTS_CONF),true)
+include $(CLEAR_VARS)
 
 LOCAL_MODULE := audio_effects.conf
 
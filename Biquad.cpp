@@ -29,6 +29,7 @@
  */
 
 #include "Biquad.h"
+#include "Fixed.h"
 #include <cmath>
 
 static double toFixedPoint(double in)
@@ -69,8 +70,61 @@ void Biquad::setCoefficients(int32_t steps, double a0, double a1, double a2, dou
 		mB2dif = (B2 - mB2) / steps;
 		mInterpolationSteps = steps;
 	}
+
+#ifdef DSP_FIXED_POINT
+	double coefficients[5] = { b0/a0, b1/a0, b2/a0, -a1/a0, -a2/a0 };
+	setFixedCoefficients(steps, coefficients);
+#endif
+}
+
+#ifdef DSP_FIXED_POINT
+static int32_t quantize(double c, int32_t shift)
+{
+	return saturate32(llrint(c * double(int64_t(1) << (30 - shift))));
 }
 
+void Biquad::setFixedCoefficients(int32_t steps, const double* c)
+{
+	/* Smallest feed forward shift with |b| < 2^(shift + 1) */
+	double peak = fabs(c[0]);
+	peak = fabs(c[1]) > peak ? fabs(c[1]) : peak;
+	peak = fabs(c[2]) > peak ? fabs(c[2]) : peak;
+	int32_t shift = 0;
+	while (shift < 24 && peak >= double(int64_t(2) << shift)) {
+		shift ++;
+	}
+
+	for (int32_t k = 0; k < 5; k ++) {
+		mQTarget[k] = quantize(c[k], k < 3 ? shift : 0);
+	}
+	mShiftTarget = shift;
+
+	if (steps == 0) {
+		for (int32_t k = 0; k < 5; k ++) {
+			mQ[k] = int64_t(mQTarget[k]) * (int64_t(1) << 32);
+		}
+		mShift = shift;
+		mQSteps = 0;
+		return;
+	}
+
+	/* Interpolate at the coarser of the two feed forward scales, then
+	 * settle on the exact target at the end. */
+	if (shift < mShift) {
+		shift = mShift;
+	}
+	for (int32_t k = 0; k < 3; k ++) {
+		mQ[k] >>= shift - mShift;
+	}
+	mShift = shift;
+	for (int32_t k = 0; k < 5; k ++) {
+		int64_t end = int64_t(quantize(c[k], k < 3 ? shift : 0)) * (int64_t(1) << 32);
+		mQdif[k] = (end - mQ[k]) / steps;
+	}
+	mQSteps = steps;
+}
+#endif
+
 void Biquad::reset()
 {
 	mInterpolationSteps = 0;
@@ -83,6 +137,20 @@ void Biquad::reset()
 	mX2 = 0;
 	mY1 = 0;
 	mY2 = 0;
+#ifdef DSP_FIXED_POINT
+	for (int32_t k = 0; k < 5; k ++) {
+		mQ[k] = 0;
+		mQTarget[k] = 0;
+	}
+	mShift = 0;
+	mShiftTarget = 0;
+	mQSteps = 0;
+	mQX1 = 0;
+	mQX2 = 0;
+	mQY1 = 0;
+	mQY2 = 0;
+	mQError = 0;
+#endif
 }
 
 void Biquad::setHighShelf(int32_t steps, double center_frequency, double sampling_frequency, double gainDb, double slope, double overallGainDb)
@@ -151,6 +219,46 @@ void Biquad::setLowPass(int32_t steps, double center_frequency, double sampling_
 	setCoefficients(steps, a0, a1, a2, b0, b1, b2);
 }
 
+void Biquad::setAllPass(int32_t steps, double center_frequency, double sampling_frequency, double resonance)
+{
+	double w0 = 2 * M_PI * center_frequency / sampling_frequency;
+	double alpha = sin(w0) / (2*resonance);
+
+	double b0 =   1 - alpha;
+	double b1 =  -2*cos(w0);
+	double b2 =   1 + alpha;
+	double a0 =   1 + alpha;
+	double a1 =  -2*cos(w0);
+	double a2 =   1 - alpha;
+
+	setCoefficients(steps, a0, a1, a2, b0, b1, b2);
+}
+
+/* Current coefficients as plain doubles, in the order b0, b1, b2, a1, a2
+ * of y0 = b0 x0 + b1 x1 + b2 x2 + a1 y1 + a2 y2. */
+void Biquad::getCoefficients(double* coefficients) const
+{
+	coefficients[0] = mB0 / 4294967296.0;
+	coefficients[1] = mB1 / 4294967296.0;
+	coefficients[2] = mB2 / 4294967296.0;
+	coefficients[3] = mA1 / 4294967296.0;
+	coefficients[4] = mA2 / 4294967296.0;
+}
+
+/* Moves towards the response of another, already designed biquad. */
+void Biquad::setFrom(int32_t steps, const Biquad& design)
+{
+	double c[5];
+	design.getCoefficients(c);
+	setFrom(steps, c);
+}
+
+/* Same, from coefficients in the order of getCoefficients(). */
+void Biquad::setFrom(int32_t steps, const double* c)
+{
+	setCoefficients(steps, 1.0, -c[3], -c[4], c[0], c[1], c[2]);
+}
+
 double Biquad::process(double x0)
 {
 	double y0 = mB0 * x0
@@ -179,3 +287,126 @@ double Biquad::process(double x0)
 
 	return y0;
 }
+
+/* Block form of process(). State and coefficients stay in registers for
+ * the whole block; in and out may be the same array. */
+void Biquad::process(const double* in, double* out, int32_t frames)
+{
+	double x1 = mX1, x2 = mX2, y1 = mY1, y2 = mY2;
+	double b0 = mB0, b1 = mB1, b2 = mB2, a1 = mA1, a2 = mA2;
+
+	int32_t i = 0;
+	while (i < frames) {
+		/* Frames still under interpolation, then the steady part. */
+		int32_t n = frames - i;
+		if (mInterpolationSteps != 0 && mInterpolationSteps < n) {
+			n = mInterpolationSteps;
+		}
+		bool interpolating = mInterpolationSteps != 0;
+
+		for (int32_t end = i + n; i < end; i ++) {
+			double x0 = in[i];
+			double y0 = (b0 * x0 + b1 * x1 + b2 * x2 + a1 * y1 + a2 * y2) / 4294967296.0;
+			y2 = y1;
+			y1 = y0;
+			x2 = x1;
+			x1 = x0;
+			out[i] = y0;
+
+			if (interpolating) {
+				b0 += mB0dif;
+				b1 += mB1dif;
+				b2 += mB2dif;
+				a1 += mA1dif;
+				a2 += mA2dif;
+			}
+		}
+
+		if (interpolating) {
+			mInterpolationSteps -= n;
+		}
+	}
+
+	mX1 = x1;
+	mX2 = x2;
+	mY1 = y1;
+	mY2 = y2;
+	mB0 = b0;
+	mB1 = b1;
+	mB2 = b2;
+	mA1 = a1;
+	mA2 = a2;
+}
+
+#ifdef DSP_FIXED_POINT
+/* Integer form of the block process(), direct form I. The remainder of
+ * each output's rounding is fed into the next one, which keeps the noise
+ * of low frequency sections near the double path. */
+void Biquad::process(const int32_t* in, int32_t* out, int32_t frames)
+{
+	int32_t x1 = mQX1, x2 = mQX2, y1 = mQY1, y2 = mQY2;
+	int64_t error = mQError;
+
+	int32_t i = 0;
+	while (i < frames) {
+		int32_t n = frames - i;
+		if (mQSteps != 0 && mQSteps < n) {
+			n = mQSteps;
+		}
+		bool interpolating = mQSteps != 0;
+
+		int64_t b0 = mQ[0], b1 = mQ[1], b2 = mQ[2], a1 = mQ[3], a2 = mQ[4];
+		int32_t shift = mShift;
+		for (int32_t end = i + n; i < end; i ++) {
+			int32_t x0 = in[i];
+			int64_t feedForward = int64_t(int32_t(b0 >> 32)) * x0
+					+ int64_t(int32_t(b1 >> 32)) * x1
+					+ int64_t(int32_t(b2 >> 32)) * x2;
+			int64_t feedBack = int64_t(int32_t(a1 >> 32)) * y1
+					+ int64_t(int32_t(a2 >> 32)) * y2;
+
+			/* The shifted feed forward sum may wrap on its own when its
+			 * terms cancel; the total fits whenever the output does. */
+			int64_t acc = int64_t((uint64_t(feedForward) << shift) + uint64_t(feedBack) + uint64_t(error));
+			int64_t y = acc >> 30;
+			error = acc - y * (int64_t(1) << 30);
+
+			int32_t y0 = saturate32(y);
+			y2 = y1;
+			y1 = y0;
+			x2 = x1;
+			x1 = x0;
+			out[i] = y0;
+
+			if (interpolating) {
+				b0 += mQdif[0];
+				b1 += mQdif[1];
+				b2 += mQdif[2];
+				a1 += mQdif[3];
+				a2 += mQdif[4];
+			}
+		}
+
+		mQ[0] = b0;
+		mQ[1] = b1;
+		mQ[2] = b2;
+		mQ[3] = a1;
+		mQ[4] = a2;
+		if (interpolating) {
+			mQSteps -= n;
+			if (mQSteps == 0) {
+				for (int32_t k = 0; k < 5; k ++) {
+					mQ[k] = int64_t(mQTarget[k]) * (int64_t(1) << 32);
+				}
+				mShift = mShiftTarget;
+			}
+		}
+	}
+
+	mQX1 = x1;
+	mQX2 = x2;
+	mQY1 = y1;
+	mQY2 = y2;
+	mQError = error;
+}
+#endif
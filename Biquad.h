@@ -12,6 +12,23 @@ class Biquad {
 
 	void setCoefficients(int32_t steps, double a0, double a1, double a2, double b0, double b1, double b2);
 
+#ifdef DSP_FIXED_POINT
+	/* Integer engine. Coefficients in the order of getCoefficients(),
+	 * feedback Q2.30 and feed forward Q.(30 - mShift) so that large
+	 * shelf gains still fit in 32 bits. Kept with 32 more fraction bits
+	 * so that they can be interpolated. */
+	int64_t mQ[5];
+	int64_t mQdif[5];
+	int32_t mQTarget[5];
+	int32_t mShift;
+	int32_t mShiftTarget;
+	int32_t mQSteps;
+	int32_t mQX1, mQX2, mQY1, mQY2;
+	int64_t mQError;
+
+	void setFixedCoefficients(int32_t steps, const double* coefficients);
+#endif
+
 	public:
 	Biquad();
 	virtual ~Biquad();
@@ -19,6 +36,14 @@ class Biquad {
 	void setBandPass(int32_t steps, double cf, double sf, double resonance);
 	void setHighPass(int32_t steps, double cf, double sf, double resonance);
 	void setLowPass(int32_t steps, double cf, double sf, double resonance);
+	void setAllPass(int32_t steps, double cf, double sf, double resonance);
+	void getCoefficients(double* coefficients) const;
+	void setFrom(int32_t steps, const Biquad& design);
+	void setFrom(int32_t steps, const double* coefficients);
 	double process(double in);
+	void process(const double* in, double* out, int32_t frames);
+#ifdef DSP_FIXED_POINT
+	void process(const int32_t* in, int32_t* out, int32_t frames);
+#endif
 	void reset();
 };
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "BiquadBank.h"
+#include "Cpu.h"
+
+BiquadBank::BiquadBank()
+	: mChannels(2), mStages(1)
+{
+#ifndef DSP_FIXED_POINT
+	v2df zero = { 0, 0 };
+	for (int32_t group = 0; group < GROUPS; group ++) {
+		for (int32_t stage = 0; stage < BIQUAD_BANK_MAX_STAGES; stage ++) {
+			mSteps[group][stage] = 0;
+			for (int32_t h = 0; h < 2; h ++) {
+				for (int32_t k = 0; k < 4; k ++) {
+					mState[group][stage][k][h] = zero;
+				}
+				for (int32_t k = 0; k < 5; k ++) {
+					mStep[group][stage][k][h] = zero;
+				}
+			}
+		}
+	}
+
+	Biquad identity;
+	for (int32_t channel = 0; channel < EFFECT_MAX_CHANNELS; channel ++) {
+		for (int32_t stage = 0; stage < BIQUAD_BANK_MAX_STAGES; stage ++) {
+			setFilter(channel, stage, 0, identity);
+		}
+	}
+#endif
+}
+
+void BiquadBank::setSize(int32_t channels, int32_t stages)
+{
+	mChannels = channels;
+	mStages = stages;
+}
+
+/* With steps, the channel's stage moves to the new response over that
+ * many frames, like Biquad's interpolation. Other channels sharing the
+ * lane group are re-aimed at their own targets over the same span. */
+void BiquadBank::setFilter(int32_t channel, int32_t stage, int32_t steps, const Biquad& design)
+{
+	double c[5];
+	design.getCoefficients(c);
+	setFilter(channel, stage, steps, c);
+}
+
+/* c in the order of Biquad::getCoefficients(). */
+void BiquadBank::setFilter(int32_t channel, int32_t stage, int32_t steps, const double* c)
+{
+#ifdef DSP_FIXED_POINT
+	mFilter[channel][stage].setFrom(steps, c);
+#else
+	int32_t group = channel / BIQUAD_BANK_LANES;
+	int32_t half = channel % BIQUAD_BANK_LANES / 2;
+	int32_t lane = channel % 2;
+
+	v2df (*coefficients)[2] = mCoefficients[group][stage];
+	v2df (*target)[2] = mTarget[group][stage];
+	v2df (*step)[2] = mStep[group][stage];
+	for (int32_t k = 0; k < 5; k ++) {
+		target[k][half][lane] = c[k];
+		if (steps == 0) {
+			coefficients[k][half][lane] = c[k];
+		}
+	}
+
+	if (steps == 0 && mSteps[group][stage] == 0) {
+		return;
+	}
+	if (steps == 0) {
+		/* Others keep interpolating; this lane just stands still. */
+		for (int32_t k = 0; k < 5; k ++) {
+			step[k][half][lane] = 0;
+		}
+		return;
+	}
+	for (int32_t k = 0; k < 5; k ++) {
+		for (int32_t h = 0; h < 2; h ++) {
+			step[k][h] = (target[k][h] - coefficients[k][h]) / double(steps);
+		}
+	}
+	mSteps[group][stage] = steps;
+#endif
+}
+
+/* Filters planes[0 .. channels) in place. */
+void BiquadBank::process(sample_t* const* planes, int32_t frames)
+{
+#ifdef DSP_FIXED_POINT
+	for (int32_t channel = 0; channel < mChannels; channel ++) {
+		for (int32_t stage = 0; stage < mStages; stage ++) {
+			mFilter[channel][stage].process(planes[channel], planes[channel], frames);
+		}
+	}
+#else
+	for (int32_t start = 0; start < frames; start += BIQUAD_BANK_BLOCK) {
+		int32_t n = frames - start < BIQUAD_BANK_BLOCK ? frames - start : BIQUAD_BANK_BLOCK;
+		for (int32_t group = 0; group * BIQUAD_BANK_LANES < mChannels; group ++) {
+			sample_t* lanes[BIQUAD_BANK_LANES];
+			for (int32_t lane = 0; lane < BIQUAD_BANK_LANES; lane ++) {
+				int32_t channel = group * BIQUAD_BANK_LANES + lane;
+				lanes[lane] = channel < mChannels ? planes[channel] + start : 0;
+			}
+			processGroup(group, lanes, n);
+		}
+	}
+#endif
+}
+
+#ifndef DSP_FIXED_POINT
+/* Four lanes as two v2df halves. SSE2 and NEON keep these in registers,
+ * where a v4df would be split through memory. */
+struct LanePair {
+	v2df l, h;
+};
+
+static CPU_INLINE LanePair operator+(LanePair a, LanePair b)
+{
+	LanePair r = { a.l + b.l, a.h + b.h };
+	return r;
+}
+
+static CPU_INLINE LanePair operator*(LanePair a, LanePair b)
+{
+	LanePair r = { a.l * b.l, a.h * b.h };
+	return r;
+}
+
+static CPU_INLINE void operator+=(LanePair& a, LanePair b)
+{
+	a.l += b.l;
+	a.h += b.h;
+}
+
+/* The type holding all four lanes: a LanePair, or one v4df where AVX
+ * makes that a single register. Wrapped, since v4df passed directly as a
+ * template argument would lose its 16 byte alignment. */
+struct PairLanes {
+	typedef LanePair Q;
+};
+
+struct VectorLanes {
+	typedef v4df Q;
+};
+
+/* Runs one stage of a lane group over x, with its coefficients and state
+ * held in registers. The coefficients are Biquad's divided by 2^32, a
+ * power of two, which leaves every rounding where Biquad has it. Like
+ * Biquad, the interpolation ends wherever the steps have added up to. */
+template <typename Lanes>
+CPU_INLINE void runStage(typename Lanes::Q* c, const typename Lanes::Q* step, int32_t* steps,
+		typename Lanes::Q* state, typename Lanes::Q* x, int32_t frames)
+{
+	typedef typename Lanes::Q Q;
+	Q b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+	Q x1 = state[0], x2 = state[1], y1 = state[2], y2 = state[3];
+
+	int32_t i = 0;
+	while (i < frames) {
+		/* Frames still under interpolation, then the steady part. */
+		int32_t n = frames - i;
+		if (*steps != 0 && *steps < n) {
+			n = *steps;
+		}
+
+		if (*steps != 0) {
+			for (int32_t end = i + n; i < end; i ++) {
+				Q x0 = x[i];
+				Q y0 = b0 * x0 + b1 * x1 + b2 * x2 + a1 * y1 + a2 * y2;
+				y2 = y1;
+				y1 = y0;
+				x2 = x1;
+				x1 = x0;
+				x[i] = y0;
+				b0 += step[0];
+				b1 += step[1];
+				b2 += step[2];
+				a1 += step[3];
+				a2 += step[4];
+			}
+			*steps -= n;
+		} else {
+			for (int32_t end = i + n; i < end; i ++) {
+				Q x0 = x[i];
+				Q y0 = b0 * x0 + b1 * x1 + b2 * x2 + a1 * y1 + a2 * y2;
+				y2 = y1;
+				y1 = y0;
+				x2 = x1;
+				x1 = x0;
+				x[i] = y0;
+			}
+		}
+	}
+
+	c[0] = b0;
+	c[1] = b1;
+	c[2] = b2;
+	c[3] = a1;
+	c[4] = a2;
+	state[0] = x1;
+	state[1] = x2;
+	state[2] = y1;
+	state[3] = y2;
+}
+
+/* Arguments are the [2] arrays of v2df halves of the bank, viewed as
+ * one four lane value each. */
+typedef void (*StageKernel)(v2df*, const v2df*, int32_t*, v2df*, v2df*, int32_t);
+
+static void runStageGeneric(v2df* c, const v2df* step, int32_t* steps, v2df* state, v2df* x, int32_t frames)
+{
+	runStage<PairLanes>((LanePair*) c, (const LanePair*) step, steps, (LanePair*) state, (LanePair*) x, frames);
+}
+
+#ifdef CPU_X86
+CPU_AVX2 static void runStageAvx2(v2df* c, const v2df* step, int32_t* steps, v2df* state, v2df* x, int32_t frames)
+{
+	runStage<VectorLanes>((v4df*) c, (const v4df*) step, steps, (v4df*) state, (v4df*) x, frames);
+}
+#endif
+
+/* One group is four lanes whatever the level, so AVX-512 runs the AVX2
+ * kernel. */
+static const StageKernel sRunStage = CPU_SELECT(runStageGeneric, runStageAvx2, runStageAvx2);
+
+/* Gathers up to four channels into lanes, runs each stage over the whole
+ * block and scatters the result back. */
+void BiquadBank::processGroup(int32_t group, sample_t* const* lanes, int32_t frames)
+{
+	for (int32_t i = 0; i < frames; i ++) {
+		v2df x[2] = { { 0, 0 }, { 0, 0 } };
+		for (int32_t lane = 0; lane < BIQUAD_BANK_LANES; lane ++) {
+			if (lanes[lane] != 0) {
+				x[lane / 2][lane % 2] = lanes[lane][i];
+			}
+		}
+		mScratch[i][0] = x[0];
+		mScratch[i][1] = x[1];
+	}
+
+	for (int32_t stage = 0; stage < mStages; stage ++) {
+		sRunStage(mCoefficients[group][stage][0], mStep[group][stage][0], &mSteps[group][stage],
+				mState[group][stage][0], mScratch[0], frames);
+	}
+
+	for (int32_t lane = 0; lane < BIQUAD_BANK_LANES; lane ++) {
+		if (lanes[lane] != 0) {
+			for (int32_t i = 0; i < frames; i ++) {
+				lanes[lane][i] = mScratch[i][lane / 2][lane % 2];
+			}
+		}
+	}
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Biquad.h"
+#include "Effect.h"
+#include "Fixed.h"
+#include "Simd.h"
+
+#define BIQUAD_BANK_MAX_STAGES 5
+
+/* Frames per internal pass of process(). */
+#define BIQUAD_BANK_BLOCK 256
+
+/* Lanes per vector group, as two native two lane halves */
+#define BIQUAD_BANK_LANES 4
+
+/* A cascade of biquad stages for each of up to EFFECT_MAX_CHANNELS planar
+ * channels, every channel with its own coefficients.
+ *
+ * Channels are processed four at a time, one per lane, so a stage costs
+ * the same for 1 .. 4 channels and 7.1.4 needs three passes rather than
+ * twelve. A group is held as two v2df halves rather than one v4df, which
+ * keeps it in registers on SSE2 and NEON, and the halves give the
+ * recursion two independent chains to overlap. With AVX2 a group is one
+ * v4df register instead, see Cpu.h. Coefficients come from a Biquad used
+ * as a designer. In DSP_FIXED_POINT builds the bank runs the integer
+ * Biquad per channel instead.
+ *
+ * Each lane does what Biquad::process() does, direct form I with the
+ * same operations in the same order and the same interpolation, so a
+ * channel's output is bit for bit that of a Biquad with its
+ * coefficients. */
+class BiquadBank {
+	int32_t mChannels;
+	int32_t mStages;
+
+#ifdef DSP_FIXED_POINT
+	Biquad mFilter[EFFECT_MAX_CHANNELS][BIQUAD_BANK_MAX_STAGES];
+#else
+	static const int32_t GROUPS = (EFFECT_MAX_CHANNELS + BIQUAD_BANK_LANES - 1) / BIQUAD_BANK_LANES;
+
+	/* b0, b1, b2, a1, a2 as in Biquad::getCoefficients(), per half */
+	v2df mCoefficients[GROUPS][BIQUAD_BANK_MAX_STAGES][5][2];
+	v2df mTarget[GROUPS][BIQUAD_BANK_MAX_STAGES][5][2];
+	v2df mStep[GROUPS][BIQUAD_BANK_MAX_STAGES][5][2];
+	int32_t mSteps[GROUPS][BIQUAD_BANK_MAX_STAGES];
+
+	/* Direct form I state: x[n - 1], x[n - 2], y[n - 1], y[n - 2] */
+	v2df mState[GROUPS][BIQUAD_BANK_MAX_STAGES][4][2];
+
+	v2df mScratch[BIQUAD_BANK_BLOCK][2];
+
+	void processGroup(int32_t group, sample_t* const* planes, int32_t frames);
+#endif
+
+	public:
+	BiquadBank();
+	void setSize(int32_t channels, int32_t stages);
+	void setFilter(int32_t channel, int32_t stage, int32_t steps, const Biquad& design);
+	void setFilter(int32_t channel, int32_t stage, int32_t steps, const double* coefficients);
+	void process(sample_t* const* planes, int32_t frames);
+};
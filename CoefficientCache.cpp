@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include "CoefficientCache.h"
+
+struct CoefficientEntry {
+	CoefficientKey key;
+	android::sp<android::VirtualLightRefBase> set;
+};
+
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static CoefficientEntry sEntries[COEFFICIENT_CACHE_SIZE];
+static int32_t sCount = 0;
+
+static bool matches(const CoefficientKey& a, const CoefficientKey& b)
+{
+	return a.kind == b.kind && a.samplingRate == b.samplingRate && a.parameters == b.parameters;
+}
+
+/* Call with sLock held. */
+static int32_t lookup(const CoefficientKey& key)
+{
+	for (int32_t i = 0; i < sCount; i ++) {
+		if (matches(sEntries[i].key, key)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+android::sp<android::VirtualLightRefBase> CoefficientCache::find(const CoefficientKey& key)
+{
+	android::sp<android::VirtualLightRefBase> set;
+	pthread_mutex_lock(&sLock);
+	int32_t i = lookup(key);
+	if (i >= 0) {
+		set = sEntries[i].set;
+	}
+	pthread_mutex_unlock(&sLock);
+	return set;
+}
+
+android::sp<android::VirtualLightRefBase> CoefficientCache::insert(const CoefficientKey& key, const android::sp<android::VirtualLightRefBase>& set)
+{
+	/* Evicted sets are released after unlocking. */
+	android::sp<android::VirtualLightRefBase> stored = set;
+	android::sp<android::VirtualLightRefBase> evicted;
+
+	pthread_mutex_lock(&sLock);
+	int32_t i = lookup(key);
+	if (i >= 0) {
+		stored = sEntries[i].set;
+	} else {
+		if (sCount == COEFFICIENT_CACHE_SIZE) {
+			/* A count of one is the cache's own reference. */
+			for (int32_t j = 0; j < sCount; j ++) {
+				if (sEntries[j].set->getStrongCount() == 1) {
+					evicted = sEntries[j].set;
+					sEntries[j] = sEntries[-- sCount];
+					sEntries[sCount].set.clear();
+					break;
+				}
+			}
+		}
+		if (sCount < COEFFICIENT_CACHE_SIZE) {
+			sEntries[sCount].key = key;
+			sEntries[sCount].set = set;
+			sCount ++;
+		}
+	}
+	pthread_mutex_unlock(&sLock);
+
+	return stored;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "system/utils/LightRefBase.h"
+#include "system/utils/StrongPointer.h"
+
+/* Entries kept at most; sets still in use are never evicted. */
+#define COEFFICIENT_CACHE_SIZE 16
+
+/* Kinds of cached sets */
+#define COEFFICIENT_HRTF_MID 0
+#define COEFFICIENT_HRTF_SIDE 1
+
+/* What a design depends on. parameters packs whatever the kind needs
+ * beyond the rate. */
+struct CoefficientKey {
+	int32_t kind;
+	int32_t samplingRate;
+	int64_t parameters;
+};
+
+/* Designs shared by every session in the process. Sessions running the
+ * same configuration hold one reference counted copy instead of each
+ * designing their own. Designing happens outside the cache, by the
+ * caller, so concurrent misses may both design; the first insert wins
+ * and the other copy is dropped. */
+class CoefficientCache {
+	public:
+	/* Returns the set stored under key, or NULL. */
+	static android::sp<android::VirtualLightRefBase> find(const CoefficientKey& key);
+	/* Stores set under key, unless a set is already there. Returns the
+	 * stored set, which callers should use in place of their own. */
+	static android::sp<android::VirtualLightRefBase> insert(const CoefficientKey& key, const android::sp<android::VirtualLightRefBase>& set);
+};
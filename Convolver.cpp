@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Convolver.h"
+#include "Cpu.h"
+#include "Simd.h"
+
+#include <string.h>
+
+/* Tail partitions are this many times larger than head partitions. */
+#define TAIL_RATIO 8
+#define MAX_TAIL_BLOCK 8192
+#define SCRATCH_SIZE 256
+
+/* Vector types of the kernel below. Wrapped, since a vector typedef
+ * passed directly as a template argument loses its 16 byte alignment. */
+struct Lanes4 {
+	typedef v4sf V;
+};
+
+#ifdef CPU_X86
+struct Lanes8 {
+	typedef v8sf V;
+};
+
+struct Lanes16 {
+	typedef v16sf V;
+};
+#endif
+
+/* acc += x * h over n complex bins, n a multiple of the lane count. The
+ * part every block spends most of its time in, one pass per partition. */
+template <typename Lanes>
+CPU_INLINE void multiplyAccumulate(float* accRe, float* accIm, const float* xRe, const float* xIm, const float* hRe, const float* hIm, int32_t n)
+{
+	typedef typename Lanes::V V;
+	const int32_t lanes = sizeof(V) / sizeof(float);
+	for (int32_t k = 0; k < n; k += lanes) {
+		V ar = *(const V*) (xRe + k), ai = *(const V*) (xIm + k);
+		V br = *(const V*) (hRe + k), bi = *(const V*) (hIm + k);
+		*(V*) (accRe + k) = *(const V*) (accRe + k) + ar * br - ai * bi;
+		*(V*) (accIm + k) = *(const V*) (accIm + k) + ar * bi + ai * br;
+	}
+}
+
+typedef void (*MultiplyAccumulateKernel)(float*, float*, const float*, const float*, const float*, const float*, int32_t);
+
+static void multiplyAccumulateGeneric(float* accRe, float* accIm, const float* xRe, const float* xIm, const float* hRe, const float* hIm, int32_t n)
+{
+	multiplyAccumulate<Lanes4>(accRe, accIm, xRe, xIm, hRe, hIm, n);
+}
+
+#ifdef CPU_X86
+CPU_AVX2 static void multiplyAccumulateAvx2(float* accRe, float* accIm, const float* xRe, const float* xIm, const float* hRe, const float* hIm, int32_t n)
+{
+	multiplyAccumulate<Lanes8>(accRe, accIm, xRe, xIm, hRe, hIm, n);
+}
+
+CPU_AVX512 static void multiplyAccumulateAvx512(float* accRe, float* accIm, const float* xRe, const float* xIm, const float* hRe, const float* hIm, int32_t n)
+{
+	multiplyAccumulate<Lanes16>(accRe, accIm, xRe, xIm, hRe, hIm, n);
+}
+#endif
+
+static const MultiplyAccumulateKernel sMultiplyAccumulate =
+	CPU_SELECT(multiplyAccumulateGeneric, multiplyAccumulateAvx2, multiplyAccumulateAvx512);
+
+ConvolverFilter::ConvolverFilter()
+	: mBlockSize(0), mPartitions(0), mRe(0), mIm(0)
+{
+}
+
+ConvolverFilter::~ConvolverFilter()
+{
+	alignedDelete(mRe);
+	alignedDelete(mIm);
+}
+
+void ConvolverFilter::design(const float* ir, int32_t length, int32_t blockSize)
+{
+	if (length <= 0) {
+		return;
+	}
+
+	mBlockSize = blockSize;
+	mPartitions = (length + blockSize - 1) / blockSize;
+	mRe = alignedNew<float>(mPartitions * blockSize);
+	mIm = alignedNew<float>(mPartitions * blockSize);
+
+	FFT fft;
+	fft.setSize(blockSize * 2);
+	float* time = alignedNew<float>(blockSize * 2);
+
+	/* Each partition is zero padded to twice its size before transform. */
+	for (int32_t p = 0; p < mPartitions; p ++) {
+		int32_t offset = p * blockSize;
+		int32_t n = length - offset < blockSize ? length - offset : blockSize;
+		memset(time, 0, blockSize * 2 * sizeof(float));
+		memcpy(time, ir + offset, n * sizeof(float));
+		fft.forward(time, mRe + offset, mIm + offset);
+	}
+
+	alignedDelete(time);
+}
+
+/* blockSize must be a power of two from 32 to 8192. */
+ConvolverResponse::ConvolverResponse(const float* ir, int32_t length, int32_t blockSize)
+	: mBlockSize(blockSize)
+{
+	/* The tail segment sees the same input, but its own latency is two
+	 * tail blocks, as its work is sliced. Starting it at
+	 * 2 tailBlock - blockSize into the response makes both segments
+	 * come out aligned. */
+	int32_t tailBlock = blockSize * TAIL_RATIO;
+	if (tailBlock > MAX_TAIL_BLOCK) {
+		tailBlock = MAX_TAIL_BLOCK;
+	}
+	int32_t split = 2 * tailBlock - blockSize;
+
+	if (tailBlock > blockSize && length > split + tailBlock) {
+		mHead.design(ir, split, blockSize);
+		mTail.design(ir + split, length - split, tailBlock);
+	} else {
+		mHead.design(ir, length, blockSize);
+	}
+}
+
+ConvolverSegment::ConvolverSegment()
+	: mBlockSize(0), mPartitions(0), mCurrent(0), mFill(0), mSlices(1), mDc(0), mNyquist(0), mFilter(0),
+		mSpectrumRe(0), mSpectrumIm(0), mSpectrumCapacity(0),
+		mAccumulatorRe(0), mAccumulatorIm(0), mInput(0), mOutput(0), mPending(0), mTime(0)
+{
+}
+
+ConvolverSegment::~ConvolverSegment()
+{
+	release();
+}
+
+void ConvolverSegment::release()
+{
+	alignedDelete(mSpectrumRe);
+	alignedDelete(mSpectrumIm);
+	alignedDelete(mAccumulatorRe);
+	alignedDelete(mAccumulatorIm);
+	alignedDelete(mInput);
+	alignedDelete(mOutput);
+	alignedDelete(mPending);
+	alignedDelete(mTime);
+	mSpectrumRe = mSpectrumIm = 0;
+	mAccumulatorRe = mAccumulatorIm = 0;
+	mInput = mOutput = mPending = mTime = 0;
+	mSpectrumCapacity = 0;
+	mBlockSize = 0;
+}
+
+/* Buffers are kept while the block size stays the same, and the input
+ * history only grows, so a new filter of the same shape does not
+ * allocate. slices must divide the block size. */
+void ConvolverSegment::setFilter(const ConvolverFilter* filter, int32_t slices)
+{
+	mFilter = filter;
+	mPartitions = filter->mPartitions;
+	mSlices = slices;
+	if (mPartitions == 0) {
+		reset();
+		return;
+	}
+
+	if (filter->mBlockSize != mBlockSize) {
+		release();
+		mBlockSize = filter->mBlockSize;
+		mFFT.setSize(mBlockSize * 2);
+		mAccumulatorRe = alignedNew<float>(mBlockSize);
+		mAccumulatorIm = alignedNew<float>(mBlockSize);
+		mInput = alignedNew<float>(mBlockSize * 2);
+		mOutput = alignedNew<float>(mBlockSize);
+		mPending = alignedNew<float>(mBlockSize);
+		mTime = alignedNew<float>(mBlockSize * 2);
+	}
+
+	int32_t bins = mPartitions * mBlockSize;
+	if (bins > mSpectrumCapacity) {
+		alignedDelete(mSpectrumRe);
+		alignedDelete(mSpectrumIm);
+		mSpectrumRe = alignedNew<float>(bins);
+		mSpectrumIm = alignedNew<float>(bins);
+		mSpectrumCapacity = bins;
+	}
+
+	reset();
+}
+
+void ConvolverSegment::reset()
+{
+	mCurrent = 0;
+	mFill = 0;
+	if (mPartitions == 0) {
+		return;
+	}
+	memset(mSpectrumRe, 0, mPartitions * mBlockSize * sizeof(float));
+	memset(mSpectrumIm, 0, mPartitions * mBlockSize * sizeof(float));
+	memset(mInput, 0, mBlockSize * 2 * sizeof(float));
+	memset(mOutput, 0, mBlockSize * sizeof(float));
+	memset(mPending, 0, mBlockSize * sizeof(float));
+
+	/* Slices run while the first block fills too, as if on a block of
+	 * silence before it. */
+	memset(mAccumulatorRe, 0, mBlockSize * sizeof(float));
+	memset(mAccumulatorIm, 0, mBlockSize * sizeof(float));
+	mDc = 0.f;
+	mNyquist = 0.f;
+}
+
+/* Transforms the block that just filled into the newest slot and
+ * starts its accumulation. */
+void ConvolverSegment::transformBlock()
+{
+	int32_t n = mBlockSize;
+
+	/* mInput holds the previous block followed by the current one. */
+	mFFT.forward(mInput, mSpectrumRe + mCurrent * n, mSpectrumIm + mCurrent * n);
+	memcpy(mInput, mInput + n, n * sizeof(float));
+
+	memset(mAccumulatorRe, 0, n * sizeof(float));
+	memset(mAccumulatorIm, 0, n * sizeof(float));
+	mDc = 0.f;
+	mNyquist = 0.f;
+}
+
+/* Adds partitions first .. end - 1 to the accumulation. Partition p
+ * meets the spectrum of the block p blocks before the newest. */
+void ConvolverSegment::multiplyPartitions(int32_t first, int32_t end)
+{
+	int32_t n = mBlockSize;
+	int32_t slot = mCurrent - first;
+	if (slot < 0) {
+		slot += mPartitions;
+	}
+	for (int32_t p = first; p < end; p ++) {
+		const float* hRe = mFilter->mRe + p * n;
+		const float* hIm = mFilter->mIm + p * n;
+		const float* xRe = mSpectrumRe + slot * n;
+		const float* xIm = mSpectrumIm + slot * n;
+
+		/* Bin 0 packs DC and Nyquist, which are both real. */
+		mDc += xRe[0] * hRe[0];
+		mNyquist += xIm[0] * hIm[0];
+		sMultiplyAccumulate(mAccumulatorRe, mAccumulatorIm, xRe, xIm, hRe, hIm, n);
+
+		slot = slot == 0 ? mPartitions - 1 : slot - 1;
+	}
+}
+
+void ConvolverSegment::finishBlock(float* output)
+{
+	int32_t n = mBlockSize;
+	mAccumulatorRe[0] = mDc;
+	mAccumulatorIm[0] = mNyquist;
+
+	/* Overlap-save: the first half is circular wrap-around, discard it. */
+	mFFT.inverse(mAccumulatorRe, mAccumulatorIm, mTime);
+	memcpy(output, mTime + n, n * sizeof(float));
+
+	mCurrent = mCurrent + 1 == mPartitions ? 0 : mCurrent + 1;
+}
+
+/* Slice 1 .. mSlices - 1 of the block transformed last; the partitions
+ * are shared out evenly between them. */
+void ConvolverSegment::runSlice(int32_t slice)
+{
+	int32_t shares = mSlices - 1;
+	multiplyPartitions(mPartitions * (slice - 1) / shares, mPartitions * slice / shares);
+	if (slice == mSlices - 1) {
+		finishBlock(mPending);
+	}
+}
+
+void ConvolverSegment::process(const float* in, float* out, int32_t frames, bool accumulate)
+{
+	if (mPartitions == 0) {
+		if (!accumulate) {
+			memset(out, 0, frames * sizeof(float));
+		}
+		return;
+	}
+
+	int32_t slice = mBlockSize / mSlices;
+	int32_t done = 0;
+	while (done < frames) {
+		/* Up to the next slice boundary, or the end of the block. */
+		int32_t n = slice - mFill % slice;
+		if (n > frames - done) {
+			n = frames - done;
+		}
+
+		memcpy(mInput + mBlockSize + mFill, in + done, n * sizeof(float));
+		if (accumulate) {
+			for (int32_t i = 0; i < n; i ++) {
+				out[done + i] += mOutput[mFill + i];
+			}
+		} else {
+			memcpy(out + done, mOutput + mFill, n * sizeof(float));
+		}
+
+		mFill += n;
+		done += n;
+		if (mFill == mBlockSize) {
+			mFill = 0;
+			if (mSlices == 1) {
+				transformBlock();
+				multiplyPartitions(0, mPartitions);
+				finishBlock(mOutput);
+			} else {
+				/* The previous block is done, it plays next. */
+				float* output = mOutput;
+				mOutput = mPending;
+				mPending = output;
+				transformBlock();
+			}
+		} else if (mFill % slice == 0) {
+			runSlice(mFill / slice);
+		}
+	}
+}
+
+Convolver::Convolver()
+	: mHasTail(false), mLatency(0), mScratch(0)
+{
+}
+
+Convolver::~Convolver()
+{
+	alignedDelete(mScratch);
+}
+
+/* blockSize must be a power of two from 32 to 8192. */
+void Convolver::setImpulseResponse(const float* ir, int32_t length, int32_t blockSize)
+{
+	setResponse(new ConvolverResponse(ir, length, blockSize));
+}
+
+void Convolver::setResponse(const android::sp<ConvolverResponse>& response)
+{
+	mResponse = response;
+	mLatency = response->mBlockSize;
+	mHasTail = response->mTail.mPartitions != 0;
+
+	mHead.setFilter(&response->mHead, 1);
+	if (mHasTail) {
+		mTail.setFilter(&response->mTail, response->mTail.mBlockSize / response->mBlockSize);
+	} else {
+		mTail.setFilter(&response->mTail, 1);
+	}
+	if (mHasTail && mScratch == 0) {
+		mScratch = alignedNew<float>(SCRATCH_SIZE);
+	}
+}
+
+void Convolver::process(const float* in, float* out, int32_t frames)
+{
+	if (!mHasTail) {
+		mHead.process(in, out, frames, false);
+		return;
+	}
+
+	/* Both segments read the input, so keep a copy in case in == out. */
+	for (int32_t done = 0; done < frames; done += SCRATCH_SIZE) {
+		int32_t n = frames - done < SCRATCH_SIZE ? frames - done : SCRATCH_SIZE;
+		memcpy(mScratch, in + done, n * sizeof(float));
+		mHead.process(mScratch, out + done, n, false);
+		mTail.process(mScratch, out + done, n, true);
+	}
+}
+
+void Convolver::reset()
+{
+	mHead.reset();
+	mTail.reset();
+}
+
+int32_t Convolver::getLatency() const
+{
+	return mLatency;
+}
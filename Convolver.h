@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "system/utils/LightRefBase.h"
+#include "system/utils/StrongPointer.h"
+
+#include "FFT.h"
+
+/* Partition spectra of one segment of an impulse response. */
+class ConvolverFilter {
+	public:
+	int32_t mBlockSize;
+	int32_t mPartitions;
+	float* mRe;
+	float* mIm;
+
+	ConvolverFilter();
+	~ConvolverFilter();
+	void design(const float* ir, int32_t length, int32_t blockSize);
+};
+
+/* A response split into head and tail filters, see Convolver. Never
+ * changes once designed, so any number of convolvers may share one. */
+class ConvolverResponse : public android::VirtualLightRefBase {
+	public:
+	ConvolverFilter mHead;
+	ConvolverFilter mTail;
+	int32_t mBlockSize;
+
+	ConvolverResponse(const float* ir, int32_t length, int32_t blockSize);
+};
+
+/* Uniformly partitioned overlap-save convolution over one segment of
+ * an impulse response. Latency is one block.
+ *
+ * With slices > 1 the work of a block is spread over that many equal
+ * stretches of the next block's input instead of running when the block
+ * fills: the forward transform in the first, the partitions in the
+ * others, the inverse transform with the last. Latency is then two
+ * blocks. */
+class ConvolverSegment {
+	FFT mFFT;
+	int32_t mBlockSize;
+	int32_t mPartitions;
+	int32_t mCurrent;
+	int32_t mFill;
+	int32_t mSlices;
+	float mDc;
+	float mNyquist;
+
+	/* Owned by the Convolver's response */
+	const ConvolverFilter* mFilter;
+	float* mSpectrumRe;
+	float* mSpectrumIm;
+	int32_t mSpectrumCapacity;
+	float* mAccumulatorRe;
+	float* mAccumulatorIm;
+	float* mInput;
+	float* mOutput;
+	float* mPending;
+	float* mTime;
+
+	void release();
+	void transformBlock();
+	void multiplyPartitions(int32_t first, int32_t end);
+	void finishBlock(float* output);
+	void runSlice(int32_t slice);
+
+	public:
+	ConvolverSegment();
+	~ConvolverSegment();
+	void setFilter(const ConvolverFilter* filter, int32_t slices);
+	void process(const float* in, float* out, int32_t frames, bool accumulate);
+	void reset();
+};
+
+/* Convolution engine for long impulse responses.
+ *
+ * The head of the response runs in small partitions of blockSize, which
+ * sets the latency. Long responses hand their tail to a second segment
+ * with partitions of tailBlock, up to eight times larger, delayed so
+ * that it lines up with the head.
+ *
+ * The tail's work is sliced over the tailBlock / blockSize head blocks
+ * that follow its block, so no single head block pays for a whole tail
+ * block. Per head block of input the worst case is the head's own
+ * forward and inverse transform of 2 blockSize and its partitions, plus
+ * the larger of one transform of 2 tailBlock, or a share of
+ * ceil(P / (slices - 1)) of the P tail partitions together with the
+ * inverse transform. The average is the same as without slicing. A
+ * host buffer of several head blocks still runs several slices, so it
+ * costs as much as those blocks together. The price is a longer head,
+ * 2 tailBlock - blockSize frames instead of tailBlock - blockSize, which
+ * moves the average by at most about 15 %. */
+class Convolver {
+	android::sp<ConvolverResponse> mResponse;
+	ConvolverSegment mHead;
+	ConvolverSegment mTail;
+	bool mHasTail;
+	int32_t mLatency;
+	float* mScratch;
+
+	public:
+	Convolver();
+	~Convolver();
+	void setImpulseResponse(const float* ir, int32_t length, int32_t blockSize);
+	void setResponse(const android::sp<ConvolverResponse>& response);
+	void process(const float* in, float* out, int32_t frames);
+	void reset();
+	int32_t getLatency() const;
+};
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef DEBUG
+#define LOG_TAG "DSP-Cpu"
+
+#include <log/log.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__arm__) || defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+#ifdef __ANDROID__
+#include <sys/system_properties.h>
+#endif
+
+#include "Cpu.h"
+
+/* Bits of AT_HWCAP, in case the libc headers lack them */
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+
+static const char* const ISA_NAMES[] = { "generic", "avx2", "avx512" };
+#define ISA_COUNT int32_t(sizeof(ISA_NAMES) / sizeof(ISA_NAMES[0]))
+
+static uint32_t probeFeatures()
+{
+	uint32_t features = 0;
+#ifdef CPU_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		features |= CPU_FEATURE_SSE2;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		features |= CPU_FEATURE_AVX2;
+	}
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+			&& __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq")) {
+		features |= CPU_FEATURE_AVX512;
+	}
+#elif defined(__arm__)
+	if (getauxval(AT_HWCAP) & HWCAP_NEON) {
+		features |= CPU_FEATURE_NEON;
+	}
+#elif defined(__aarch64__)
+	unsigned long hwcap = getauxval(AT_HWCAP);
+	if (hwcap & HWCAP_ASIMD) {
+		features |= CPU_FEATURE_ASIMD;
+	}
+	if (hwcap & HWCAP_SVE) {
+		features |= CPU_FEATURE_SVE;
+	}
+#endif
+	return features;
+}
+
+/* The named level, or -1. */
+static int32_t requestedIsa()
+{
+#ifdef __ANDROID__
+	char value[PROP_VALUE_MAX];
+	if (__system_property_get("debug.dsp.isa", value) <= 0) {
+		return -1;
+	}
+#else
+	const char* value = getenv("DSP_ISA");
+	if (value == NULL) {
+		return -1;
+	}
+#endif
+	for (int32_t isa = 0; isa < ISA_COUNT; isa ++) {
+		if (strcmp(value, ISA_NAMES[isa]) == 0) {
+			return isa;
+		}
+	}
+	return -1;
+}
+
+static int32_t probeIsa()
+{
+	uint32_t features = cpuFeatures();
+	int32_t isa = CPU_ISA_GENERIC;
+	if (features & CPU_FEATURE_AVX2) {
+		isa = features & CPU_FEATURE_AVX512 ? CPU_ISA_AVX512 : CPU_ISA_AVX2;
+	}
+
+	/* Only ever lower: a level the CPU lacks would fault. */
+	int32_t requested = requestedIsa();
+	if (requested >= 0 && requested < isa) {
+		isa = requested;
+	}
+#ifdef DEBUG
+	ALOGI("kernels: %s, features %#x", ISA_NAMES[isa], features);
+#endif
+	return isa;
+}
+
+uint32_t cpuFeatures()
+{
+	static const uint32_t features = probeFeatures();
+	return features;
+}
+
+int32_t cpuIsa()
+{
+	static const int32_t isa = probeIsa();
+	return isa;
+}
+
+const char* cpuIsaName(int32_t isa)
+{
+	return isa >= 0 && isa < ISA_COUNT ? ISA_NAMES[isa] : "unknown";
+}
+
+void cpuDump(int fd)
+{
+	static const struct {
+		uint32_t feature;
+		const char* name;
+	} FEATURES[] = {
+		{ CPU_FEATURE_SSE2, "sse2" },
+		{ CPU_FEATURE_AVX2, "avx2" },
+		{ CPU_FEATURE_AVX512, "avx512" },
+		{ CPU_FEATURE_NEON, "neon" },
+		{ CPU_FEATURE_ASIMD, "asimd" },
+		{ CPU_FEATURE_SVE, "sve" },
+	};
+
+	uint32_t features = cpuFeatures();
+	dprintf(fd, "    kernels: %s, cpu:", cpuIsaName(cpuIsa()));
+	for (uint32_t i = 0; i < sizeof(FEATURES) / sizeof(FEATURES[0]); i ++) {
+		if (features & FEATURES[i].feature) {
+			dprintf(fd, " %s", FEATURES[i].name);
+		}
+	}
+	dprintf(fd, "\n");
+}
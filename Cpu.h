@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Features found by the probe, see cpuFeatures(). */
+#define CPU_FEATURE_SSE2 (1 << 0)
+#define CPU_FEATURE_AVX2 (1 << 1)
+#define CPU_FEATURE_AVX512 (1 << 2)
+#define CPU_FEATURE_NEON (1 << 3)
+#define CPU_FEATURE_ASIMD (1 << 4)
+#define CPU_FEATURE_SVE (1 << 5)
+
+/* Instruction set levels the kernels are built for, best last.
+ *
+ * GENERIC is the build's own target: SSE2 on x86, NEON on armv7-a-neon
+ * and arm64, plain scalar code on other ABIs, where the compiler lowers
+ * the vector types to scalars. It always works and is the fallback. The
+ * x86 levels are compiled in besides it and taken when the CPU has
+ * them. AVX2 leaves out FMA so that every level computes bit for bit
+ * the same output. */
+#define CPU_ISA_GENERIC 0
+#define CPU_ISA_AVX2 1
+#define CPU_ISA_AVX512 2
+
+/* Kernel bodies are written once as CPU_INLINE templates and
+ * instantiated in one small entry point per level; CPU_SELECT() picks
+ * the entry point when the library is loaded:
+ *
+ *	static void mixGeneric(...) { mix<v4sf>(...); }
+ *	#ifdef CPU_X86
+ *	CPU_AVX2 static void mixAvx2(...) { mix<v8sf>(...); }
+ *	CPU_AVX512 static void mixAvx512(...) { mix<v16sf>(...); }
+ *	#endif
+ *	static const MixKernel sMix = CPU_SELECT(mixGeneric, mixAvx2, mixAvx512);
+ */
+#define CPU_INLINE inline __attribute__((always_inline))
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#define CPU_AVX2 __attribute__((target("avx2")))
+#define CPU_AVX512 __attribute__((target("avx2,avx512f,avx512vl,avx512bw,avx512dq")))
+#define CPU_SELECT(generic, avx2, avx512) cpuSelect(generic, avx2, avx512)
+#else
+#define CPU_SELECT(generic, avx2, avx512) (generic)
+#endif
+
+/* CPU_FEATURE_* of the CPU the library runs on. */
+uint32_t cpuFeatures();
+
+/* The level kernels run at: the best one the CPU has, or the one named
+ * by the debug.dsp.isa property (DSP_ISA in the environment off
+ * Android) if that is lower, for testing the fallbacks. */
+int32_t cpuIsa();
+
+const char* cpuIsaName(int32_t isa);
+
+/* Prints features and level, for EFFECT_CMD_DUMP. */
+void cpuDump(int fd);
+
+template <typename T>
+inline T cpuSelect(T generic, T avx2, T avx512)
+{
+	switch (cpuIsa()) {
+	case CPU_ISA_AVX512:
+		return avx512;
+	case CPU_ISA_AVX2:
+		return avx2;
+	default:
+		return generic;
+	}
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Crossover.h"
+#include "Biquad.h"
+#include "Cpu.h"
+
+#include <cmath>
+
+/* One biquad stage of all four bands over frames. */
+static CPU_INLINE void runStage(const v4df* c, v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	v4df b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+	v4df z1 = *s1, z2 = *s2;
+	for (int32_t i = 0; i < frames; i ++) {
+		v4df x = bands[i];
+		v4df y = b0 * x + z1;
+		z1 = b1 * x + a1 * y + z2;
+		z2 = b2 * x + a2 * y;
+		bands[i] = y;
+	}
+	*s1 = z1;
+	*s2 = z2;
+}
+
+/* One frame x through stages [0, Stage), unrolled at compile time so
+ * that every stage's state stays in registers. */
+template <int32_t Stage>
+static CPU_INLINE void cascade(const v4df (*c)[5], v4df* z1, v4df* z2, v4df* x)
+{
+	cascade<Stage - 1>(c, z1, z2, x);
+	const v4df* k = c[Stage - 1];
+	v4df y = k[0] * *x + z1[Stage - 1];
+	z1[Stage - 1] = k[1] * *x + k[3] * y + z2[Stage - 1];
+	z2[Stage - 1] = k[2] * *x + k[4] * y;
+	*x = y;
+}
+
+template <>
+CPU_INLINE void cascade<0>(const v4df (*)[5], v4df*, v4df*, v4df*)
+{
+}
+
+/* All Stages stages per frame. Each stage's recursion waits on its
+ * previous frame only, so the stages of neighbouring frames overlap,
+ * where one stage at a time waits out the latency of every frame. The
+ * arithmetic of each stage is the same as in runStage(). */
+template <int32_t Stages>
+static CPU_INLINE void runStages(const v4df (*c)[5], v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	v4df z1[Stages], z2[Stages];
+	for (int32_t k = 0; k < Stages; k ++) {
+		z1[k] = s1[k];
+		z2[k] = s2[k];
+	}
+	for (int32_t i = 0; i < frames; i ++) {
+		v4df x = bands[i];
+		cascade<Stages>(c, z1, z2, &x);
+		bands[i] = x;
+	}
+	for (int32_t k = 0; k < Stages; k ++) {
+		s1[k] = z1[k];
+		s2[k] = z2[k];
+	}
+}
+
+typedef void (*StageKernel)(const v4df*, v4df*, v4df*, v4df*, int32_t);
+typedef void (*StagesKernel)(const v4df (*)[5], v4df*, v4df*, v4df*, int32_t);
+
+static void runStageGeneric(const v4df* c, v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	runStage(c, s1, s2, bands, frames);
+}
+
+/* Three bands take four stages, four bands six. */
+static void runStages4Generic(const v4df (*c)[5], v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	runStages<4>(c, s1, s2, bands, frames);
+}
+
+static void runStages6Generic(const v4df (*c)[5], v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	runStages<6>(c, s1, s2, bands, frames);
+}
+
+#ifdef CPU_X86
+CPU_AVX2 static void runStageAvx2(const v4df* c, v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	runStage(c, s1, s2, bands, frames);
+}
+
+CPU_AVX2 static void runStages4Avx2(const v4df (*c)[5], v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	runStages<4>(c, s1, s2, bands, frames);
+}
+
+CPU_AVX2 static void runStages6Avx2(const v4df (*c)[5], v4df* s1, v4df* s2, v4df* bands, int32_t frames)
+{
+	runStages<6>(c, s1, s2, bands, frames);
+}
+#endif
+
+static const StageKernel sRunStage = CPU_SELECT(runStageGeneric, runStageAvx2, runStageAvx2);
+static const StagesKernel sRunStages4 = CPU_SELECT(runStages4Generic, runStages4Avx2, runStages4Avx2);
+static const StagesKernel sRunStages6 = CPU_SELECT(runStages6Generic, runStages6Avx2, runStages6Avx2);
+
+Crossover::Crossover()
+	: mBands(1), mStages(0)
+{
+	setBands(1, 0, 48000.0);
+}
+
+/* frequencies holds bands - 1 ascending crossover points. */
+void Crossover::setBands(int32_t bands, const double* frequencies, double samplingRate)
+{
+	if (bands < 1) {
+		bands = 1;
+	}
+	if (bands > CROSSOVER_MAX_BANDS) {
+		bands = CROSSOVER_MAX_BANDS;
+	}
+	mBands = bands;
+	mStages = 2 * (bands - 1);
+
+	/* Butterworth sections; two in series make one LR4 filter, and the
+	 * second order all pass at the same Q has the phase of their sum. */
+	const double q = sqrt(0.5);
+	Biquad designer;
+	double c[5];
+
+	for (int32_t band = 0; band < CROSSOVER_MAX_BANDS; band ++) {
+		int32_t stage = 0;
+		for (int32_t i = 0; i < bands - 1 && band < bands; i ++) {
+			double frequency = frequencies[i];
+			if (frequency > samplingRate * 0.45) {
+				frequency = samplingRate * 0.45;
+			}
+
+			int32_t sections = 2;
+			if (i < band) {
+				designer.setHighPass(0, frequency, samplingRate, q);
+			} else if (i == band) {
+				designer.setLowPass(0, frequency, samplingRate, q);
+			} else {
+				designer.setAllPass(0, frequency, samplingRate, q);
+				sections = 1;
+			}
+
+			designer.getCoefficients(c);
+			for (int32_t j = 0; j < sections; j ++) {
+				for (int32_t k = 0; k < 5; k ++) {
+					mCoefficients[stage][k][band] = c[k];
+				}
+				stage ++;
+			}
+		}
+
+		/* Pad with identity stages. Lanes above the band count stay
+		 * silent. */
+		for (; stage < CROSSOVER_STAGES; stage ++) {
+			mCoefficients[stage][0][band] = band < bands ? 1.0 : 0.0;
+			for (int32_t k = 1; k < 5; k ++) {
+				mCoefficients[stage][k][band] = 0;
+			}
+		}
+	}
+
+	/* With a single band, one identity stage still copies the input to
+	 * lane 0. */
+	if (mStages == 0) {
+		mStages = 1;
+	}
+
+	reset();
+}
+
+int32_t Crossover::getBands() const
+{
+	return mBands;
+}
+
+/* Splits frames of one channel into bands[i][0 .. 3]. The three and four
+ * band cascades run all their stages per frame; any other count runs
+ * stage by stage over the whole block. */
+void Crossover::process(int32_t channel, const sample_t* in, v4df* bands, int32_t frames)
+{
+	for (int32_t i = 0; i < frames; i ++) {
+		double x = in[i];
+		v4df v = { x, x, x, x };
+		bands[i] = v;
+	}
+
+	if (mStages == 4) {
+		sRunStages4(mCoefficients, mS1[channel], mS2[channel], bands, frames);
+		return;
+	}
+	if (mStages == 6) {
+		sRunStages6(mCoefficients, mS1[channel], mS2[channel], bands, frames);
+		return;
+	}
+	for (int32_t stage = 0; stage < mStages; stage ++) {
+		sRunStage(mCoefficients[stage], &mS1[channel][stage], &mS2[channel][stage], bands, frames);
+	}
+}
+
+void Crossover::reset()
+{
+	v4df zero = { 0, 0, 0, 0 };
+	for (int32_t channel = 0; channel < EFFECT_MAX_CHANNELS; channel ++) {
+		for (int32_t stage = 0; stage < CROSSOVER_STAGES; stage ++) {
+			mS1[channel][stage] = zero;
+			mS2[channel][stage] = zero;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Effect.h"
+#include "Fixed.h"
+#include "Simd.h"
+
+/* Up to four bands, three crossovers. */
+#define CROSSOVER_MAX_BANDS 4
+#define CROSSOVER_STAGES (2 * (CROSSOVER_MAX_BANDS - 1))
+
+/* Linkwitz-Riley band splitter for up to EFFECT_MAX_CHANNELS channels, one band per SIMD lane.
+ *
+ * Rather than a tree of splits, every band runs its own cascade from the
+ * input: LR4 low pass at its upper edge, LR4 high pass at each crossover
+ * below it, and an LR4 phase matching all pass at each crossover above
+ * it. All cascades then have the same shape, so one biquad stage
+ * advances all four bands at once, and the bands still sum back to an
+ * all pass response. */
+class Crossover {
+	int32_t mBands;
+	int32_t mStages;
+
+	/* Per stage b0, b1, b2, a1, a2 as in Biquad::getCoefficients(), one
+	 * lane per band */
+	v4df mCoefficients[CROSSOVER_STAGES][5];
+
+	/* Transposed direct form II state per channel and stage */
+	v4df mS1[EFFECT_MAX_CHANNELS][CROSSOVER_STAGES];
+	v4df mS2[EFFECT_MAX_CHANNELS][CROSSOVER_STAGES];
+
+	public:
+	Crossover();
+	void setBands(int32_t bands, const double* frequencies, double samplingRate);
+	int32_t getBands() const;
+	void process(int32_t channel, const sample_t* in, v4df* bands, int32_t frames);
+	void reset();
+};
@@ -19,7 +19,7 @@
 #include <string.h>
 
 Delay::Delay()
-	: mState(0), mIndex(0), mLength(0)
+	: mState(0), mIndex(0), mLength(0), mCapacity(0)
 {
 }
 
@@ -31,14 +31,18 @@ Delay::~Delay()
 	}
 }
 
+/* Storage only grows, so shortening a delay never allocates. */
 void Delay::setParameters(float samplingFrequency, float time)
 {
 	mLength = int32_t(time * samplingFrequency + 0.5f);
-	if (mState != 0) {
-		delete[] mState;
+	if (mLength > mCapacity) {
+		if (mState != 0) {
+			delete[] mState;
+		}
+		mState = new double[mLength];
+		mCapacity = mLength;
 	}
-	mState = new double[mLength];
-	memset(mState, 0, mLength * sizeof(int32_t));
+	memset(mState, 0, mLength * sizeof(double));
 	mIndex = 0;
 }
 
@@ -49,3 +53,31 @@ double Delay::process(double x0)
 	mIndex = (mIndex + 1) % mLength;
 	return y0;
 }
+
+/* Block form of process(): read() fetches the next frames outputs and
+ * write() then stores as many inputs. frames must not exceed the length. */
+void Delay::read(double* out, int32_t frames)
+{
+	int32_t n = mLength - mIndex;
+	if (n > frames) {
+		n = frames;
+	}
+	memcpy(out, mState + mIndex, n * sizeof(double));
+	memcpy(out + n, mState, (frames - n) * sizeof(double));
+}
+
+void Delay::write(const double* in, int32_t frames)
+{
+	int32_t n = mLength - mIndex;
+	if (n > frames) {
+		n = frames;
+	}
+	memcpy(mState + mIndex, in, n * sizeof(double));
+	memcpy(mState, in + n, (frames - n) * sizeof(double));
+	mIndex = (mIndex + frames) % mLength;
+}
+
+int32_t Delay::getLength() const
+{
+	return mLength;
+}
@@ -6,10 +6,14 @@ class Delay {
 	double* mState;
 	int32_t mIndex;
 	int32_t mLength;
+	int32_t mCapacity;
 
 	public:
 	Delay();
 	~Delay();
 	void setParameters(float rate, float time);
 	double process(double x0);
+	void read(double* out, int32_t frames);
+	void write(const double* in, int32_t frames);
+	int32_t getLength() const;
 };
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef DEBUG
+#define LOG_TAG "Effect-Designer"
+
+#include <log/log.h>
+#endif
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "Designer.h"
+
+/* sLifecycle serializes attach() and detach(), including starting and
+ * joining the thread. sJobs is walked by the thread under sLock, which
+ * the audio thread never takes. */
+static pthread_mutex_t sLifecycle = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static sem_t sWake;
+static pthread_t sThread;
+static DesignerJob* sJobs = 0;
+static int32_t sCount = 0;
+static bool sRunning = false;
+static bool sQuit = false;
+
+DesignerJob::DesignerJob()
+	: mPending(false), mNext(0)
+{
+}
+
+DesignerJob::~DesignerJob()
+{
+}
+
+void* Designer::loop(void*)
+{
+	setpriority(PRIO_PROCESS, gettid(), DESIGNER_NICE);
+
+	for (;;) {
+		while (sem_wait(&sWake) != 0) {
+		}
+
+		pthread_mutex_lock(&sLock);
+		if (sQuit) {
+			pthread_mutex_unlock(&sLock);
+			return 0;
+		}
+		for (DesignerJob* job = sJobs; job != 0; job = job->mNext) {
+			if (job->mPending.exchange(false, std::memory_order_acquire)) {
+				job->design();
+			}
+		}
+		pthread_mutex_unlock(&sLock);
+	}
+}
+
+bool Designer::attach(DesignerJob* job)
+{
+	pthread_mutex_lock(&sLifecycle);
+	if (sCount == 0) {
+		sem_init(&sWake, 0, 0);
+		sQuit = false;
+		sRunning = pthread_create(&sThread, NULL, loop, NULL) == 0;
+#ifdef DEBUG
+		if (!sRunning) {
+			ALOGE("Unable to start the designer thread");
+		}
+#endif
+	}
+	sCount ++;
+	bool running = sRunning;
+
+	pthread_mutex_lock(&sLock);
+	job->mNext = sJobs;
+	sJobs = job;
+	pthread_mutex_unlock(&sLock);
+	pthread_mutex_unlock(&sLifecycle);
+	return running;
+}
+
+void Designer::detach(DesignerJob* job)
+{
+	pthread_mutex_lock(&sLifecycle);
+	pthread_mutex_lock(&sLock);
+	for (DesignerJob** link = &sJobs; *link != 0; link = &(*link)->mNext) {
+		if (*link == job) {
+			*link = job->mNext;
+			break;
+		}
+	}
+	sCount --;
+	sQuit = sCount == 0;
+	pthread_mutex_unlock(&sLock);
+
+	if (sCount == 0) {
+		if (sRunning) {
+			sem_post(&sWake);
+			pthread_join(sThread, NULL);
+			sRunning = false;
+		}
+		sem_destroy(&sWake);
+	}
+	pthread_mutex_unlock(&sLifecycle);
+}
+
+void Designer::cancel(DesignerJob* job)
+{
+	pthread_mutex_lock(&sLock);
+	job->mPending.store(false, std::memory_order_relaxed);
+	pthread_mutex_unlock(&sLock);
+}
+
+/* One wake up per batch of requests: later ones find the job pending. */
+void Designer::request(DesignerJob* job)
+{
+	if (!job->mPending.exchange(true, std::memory_order_release)) {
+		sem_post(&sWake);
+	}
+}
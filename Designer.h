@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+/* Nice value of the designer thread, ANDROID_PRIORITY_BACKGROUND */
+#define DESIGNER_NICE 10
+
+/* Work that the designer thread runs on behalf of an effect. */
+class DesignerJob {
+	friend class Designer;
+
+	std::atomic<bool> mPending;
+	DesignerJob* mNext;
+
+	public:
+	DesignerJob();
+	virtual ~DesignerJob();
+
+	/* Runs on the designer thread, never concurrently with itself. */
+	virtual void design() = 0;
+};
+
+/* One low priority thread, shared by every effect instance, that runs
+ * filter design off the audio thread. The thread exists while at least
+ * one job is attached. Jobs exchange their inputs and results with the
+ * audio thread through ParameterBuffer. */
+class Designer {
+	static void* loop(void* arg);
+
+	public:
+	/* Returns false if the thread could not be started; the caller
+	 * then designs inline. Either way detach() must follow. */
+	static bool attach(DesignerJob* job);
+	/* Returns once the job is no longer running. */
+	static void detach(DesignerJob* job);
+	/* Drops a pending request. Returns once the job is no longer
+	 * running. */
+	static void cancel(DesignerJob* job);
+	/* Audio thread: asks for job->design() to run soon. Does not block. */
+	static void request(DesignerJob* job);
+};
@@ -20,10 +20,16 @@
 #include <log/log.h>
 #endif
 
+#include <float.h>
+#include <string.h>
+
+#include "system/utils/Timers.h"
+
+#include "Cpu.h"
 #include "Effect.h"
 
 Effect::Effect()
-	: mSamplingRate(48000.0), formatFloatModeInt32Mode(0)
+	: mEnable(false), mSamplingRate(48000.0), mChannels(2), mInputFormat(AUDIO_FORMAT_PCM_16_BIT), mOutputFormat(AUDIO_FORMAT_PCM_16_BIT), mDeferParameters(false)
 {
 }
 
@@ -31,6 +37,19 @@ Effect::~Effect()
 {
 }
 
+void Effect::recycle()
+{
+	mEnable = false;
+	mSamplingRate = 48000.0;
+	mChannels = 2;
+	mInputFormat = AUDIO_FORMAT_PCM_16_BIT;
+	mOutputFormat = AUDIO_FORMAT_PCM_16_BIT;
+	mDither = PcmDither();
+	mDeferParameters = false;
+	mStats.reset();
+	mTrace.reset();
+}
+
 /* Configure a bunch of general parameters. */
 int32_t Effect::configure(void* pCmdData)
 {
@@ -50,68 +69,53 @@ int32_t Effect::configure(void* pCmdData)
 		mSamplingRate = (double)in.samplingRate;
 	}
 
+	/* Any layout from stereo to 7.1.4 is processed natively; input and
+	 * output must match. */
 	if (in.mask & EFFECT_CONFIG_CHANNELS && out.mask & EFFECT_CONFIG_CHANNELS) {
-		if (in.channels != AUDIO_CHANNEL_OUT_STEREO) {
+		int32_t channels = audio_channel_count_from_out_mask(in.channels);
+		if (channels < 2 || channels > EFFECT_MAX_CHANNELS) {
 #ifdef DEBUG
 			ALOGE("Invalid input channel setup: 0x%x", in.channels);
 #endif
 			return -EINVAL;
 		}
-		if (out.channels != AUDIO_CHANNEL_OUT_STEREO) {
+		if (out.channels != in.channels) {
 #ifdef DEBUG
-			ALOGE("Invalid output channel setup: 0x%x", in.channels);
+			ALOGE("Invalid output channel setup: 0x%x", out.channels);
 #endif
 			return -EINVAL;
 		}
+		mChannels = channels;
 	}
 
+	/* Every PCM format we can convert natively is accepted, so that the
+	 * framework does not insert conversions around the effect. Anything
+	 * else is refused rather than read as the wrong format. */
 	if (in.mask & EFFECT_CONFIG_FORMAT) {
-		if (in.format == AUDIO_FORMAT_PCM_16_BIT) {
-			formatFloatModeInt32Mode = 0;
+		if (!pcmIsSupported((audio_format_t) in.format)) {
 #ifdef DEBUG
-			ALOGI("16bit PCM input detect: 0x%x", in.format);
-#endif
-		}
-		else if (in.format == AUDIO_FORMAT_PCM_FLOAT) {
-			formatFloatModeInt32Mode = 1;
-#ifdef DEBUG
-			ALOGI("Float PCM input detect: 0x%x", in.format);
-#endif
-		}
-		else if (in.format == AUDIO_FORMAT_PCM_32_BIT) {
-			formatFloatModeInt32Mode = 2;
-#ifdef DEBUG
-			ALOGI("32bit PCM input detect: 0x%x", in.format);
+			ALOGE("Invalid input format (need corrected PCM): 0x%x", in.format);
 #endif
+			return -EINVAL;
 		}
-		else {
 #ifdef DEBUG
-			ALOGE("Invalid input format (need corrected PCM): 0x%x", in.format);
+		ALOGI("PCM input format: 0x%x", in.format);
 #endif
-		}
+		mInputFormat = (audio_format_t) in.format;
+		mOutputFormat = (audio_format_t) in.format;
 	}
 
 	if (out.mask & EFFECT_CONFIG_FORMAT) {
-		if (out.format == AUDIO_FORMAT_PCM_16_BIT) {
+		if (!pcmIsSupported((audio_format_t) out.format)) {
 #ifdef DEBUG
-			ALOGI("16bit pcm output detect: 0x%x", out.format);
-#endif
-		}
-		else if (out.format == AUDIO_FORMAT_PCM_FLOAT) {
-#ifdef DEBUG
-			ALOGI("Float pcm output detect: 0x%x", out.format);
-#endif
-		}
-		else if (out.format == AUDIO_FORMAT_PCM_32_BIT) {
-#ifdef DEBUG
-			ALOGI("32bit PCM output detect: 0x%x", in.format);
+			ALOGE("Invalid output format (need corrected PCM): 0x%x", out.format);
 #endif
+			return -EINVAL;
 		}
-		else {
 #ifdef DEBUG
-			ALOGE("Invalid output format (need corrected PCM): 0x%x", out.format);
+		ALOGI("PCM output format: 0x%x", out.format);
 #endif
-		}
+		mOutputFormat = (audio_format_t) out.format;
 	}
 
 	if (out.mask & EFFECT_CONFIG_ACC_MODE) {
@@ -121,7 +125,155 @@ int32_t Effect::configure(void* pCmdData)
 	return 0;
 }
 
-int32_t Effect::command(uint32_t cmdCode, uint32_t __attribute__((unused))cmdSize, void * __attribute__((unused))pCmdData, uint32_t *replySize, void* pReplyData)
+void Effect::readPlanes(audio_buffer_t *in, uint32_t first, double* const* planes, int32_t frames)
+{
+	pcmRead(in, mInputFormat, mChannels, first, frames, planes);
+}
+
+/* Nonzero samples below this would be denormal as float output */
+#define DENORMAL_LEVEL (FLT_MIN * PCM_FULL_SCALE)
+
+static inline uint64_t magnitudeBits(double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	return bits & INT64_MAX;
+}
+
+/* Adds the samples at or over full scale and the nonzero ones below
+ * DENORMAL_LEVEL. Both are rare, so a first pass only finds out whether
+ * there is anything to count. It compares magnitudes as integers, which
+ * order the same way as the doubles and leave no branch in the loop. */
+static void countLevels(const double* plane, int32_t frames, uint64_t* clipped, uint64_t* denormals)
+{
+	const uint64_t full = magnitudeBits(PCM_FULL_SCALE);
+	const uint64_t tiny = magnitudeBits(DENORMAL_LEVEL);
+
+	uint64_t found = 0;
+	for (int32_t i = 0; i < frames; i ++) {
+		uint64_t level = magnitudeBits(plane[i]);
+		/* level - 1 wraps around for zero */
+		found |= (level >= full) | (level - 1 < tiny - 1);
+	}
+	if (found == 0) {
+		return;
+	}
+
+	for (int32_t i = 0; i < frames; i ++) {
+		uint64_t level = magnitudeBits(plane[i]);
+		*clipped += level >= full;
+		*denormals += level - 1 < tiny - 1;
+	}
+}
+
+void Effect::writePlanes(audio_buffer_t *out, uint32_t first, const double* const* planes, int32_t frames)
+{
+	uint64_t clipped = 0, denormals = 0;
+	for (int32_t c = 0; c < mChannels; c ++) {
+		countLevels(planes[c], frames, &clipped, &denormals);
+	}
+	mStats.recordSamples(clipped, denormals);
+
+	pcmWrite(out, mOutputFormat, mChannels, first, frames, planes, &mDither);
+}
+
+int32_t Effect::processBuffer(audio_buffer_t *in, audio_buffer_t *out)
+{
+	uint32_t generation = mTrace.generation();
+	nsecs_t start = systemTime();
+	int32_t status = process(in, out);
+	nsecs_t duration = systemTime() - start;
+	mStats.recordCall(in->frameCount, duration, status == -ENODATA);
+	mTrace.record(start, duration, in->frameCount, generation, getTraceState());
+	return status;
+}
+
+int32_t Effect::handleCommand(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData, const char* name)
+{
+	switch (cmdCode) {
+		case EFFECT_CMD_GET_TRACE: {
+			if (pReplyData == NULL || replySize == NULL || *replySize < sizeof(effect_trace_header_s)) {
+				return -EINVAL;
+			}
+			effect_trace_header_s* header = (effect_trace_header_s *) pReplyData;
+			uint32_t capacity = (*replySize - sizeof(effect_trace_header_s)) / sizeof(effect_trace_record_s);
+			header->count = mTrace.read((effect_trace_record_s *) (header + 1), capacity, &header->dropped);
+			*replySize = sizeof(effect_trace_header_s) + header->count * sizeof(effect_trace_record_s);
+			return 0;
+		}
+
+		case EFFECT_CMD_DUMP_TRACE:
+			if (pCmdData != NULL && cmdSize >= sizeof(uint32_t)) {
+				mTrace.dumpJson(*(uint32_t *) pCmdData, name);
+			}
+			return 0;
+	}
+
+	int32_t status = command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+	switch (cmdCode) {
+		case EFFECT_CMD_ENABLE:
+		case EFFECT_CMD_DISABLE:
+		case EFFECT_CMD_RESET:
+		case EFFECT_CMD_SET_CONFIG:
+		case EFFECT_CMD_SET_PARAM:
+		case EFFECT_CMD_SET_PARAM_COMMIT:
+			if (status == 0) {
+				mTrace.changed();
+			}
+			break;
+	}
+	return status;
+}
+
+int32_t Effect::process(audio_buffer_t *in, audio_buffer_t *out)
+{
+	double* planes[EFFECT_MAX_CHANNELS];
+	for (int32_t c = 0; c < mChannels; c ++) {
+		planes[c] = mPlanes[c];
+	}
+
+	int32_t status = 0;
+	for (uint32_t start = 0; start < in->frameCount; start += EFFECT_BLOCK) {
+		int32_t n = in->frameCount - start < EFFECT_BLOCK ? in->frameCount - start : EFFECT_BLOCK;
+
+		readPlanes(in, start, planes, n);
+		status = processPlanes(planes, n);
+		writePlanes(out, start, planes, n);
+	}
+
+	return status;
+}
+
+#ifdef DSP_FIXED_POINT
+void Effect::readPlanes(audio_buffer_t *in, uint32_t first, int32_t* const* planes, int32_t frames)
+{
+	pcmRead(in, mInputFormat, mChannels, first, frames, planes);
+}
+
+void Effect::writePlanes(audio_buffer_t *out, uint32_t first, const int32_t* const* planes, int32_t frames)
+{
+	uint64_t clipped = 0;
+	for (int32_t c = 0; c < mChannels; c ++) {
+		for (int32_t i = 0; i < frames; i ++) {
+			clipped += planes[c][i] >= int32_t(PCM_FULL_SCALE) || planes[c][i] <= -int32_t(PCM_FULL_SCALE);
+		}
+	}
+	mStats.recordSamples(clipped, 0);
+
+	pcmWrite(out, mOutputFormat, mChannels, first, frames, planes, &mDither);
+}
+#endif
+
+void Effect::commitParameters()
+{
+}
+
+float Effect::getTraceState()
+{
+	return 0.0f;
+}
+
+int32_t Effect::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t *replySize, void* pReplyData)
 {
 	switch (cmdCode) {
 		case EFFECT_CMD_ENABLE:
@@ -134,15 +286,31 @@ int32_t Effect::command(uint32_t cmdCode, uint32_t __attribute__((unused))cmdSiz
 
 		case EFFECT_CMD_INIT:
 		case EFFECT_CMD_SET_CONFIG:
-		case EFFECT_CMD_SET_PARAM:
+		case EFFECT_CMD_SET_PARAM: {
+			int32_t *replyData = (int32_t *) pReplyData;
+			*replyData = 0;
+			break;
+		}
+
+		/* Handled as SET_PARAM by the effect, minus the publication.
+		 * There is no reply. */
+		case EFFECT_CMD_SET_PARAM_DEFERRED: {
+			int32_t reply = 0;
+			uint32_t size = sizeof(reply);
+			mDeferParameters = true;
+			command(EFFECT_CMD_SET_PARAM, cmdSize, pCmdData, &size, &reply);
+			mDeferParameters = false;
+			break;
+		}
+
 		case EFFECT_CMD_SET_PARAM_COMMIT: {
+			commitParameters();
 			int32_t *replyData = (int32_t *) pReplyData;
 			*replyData = 0;
 			break;
 		}
 
 		case EFFECT_CMD_RESET:
-		case EFFECT_CMD_SET_PARAM_DEFERRED:
 		case EFFECT_CMD_SET_DEVICE:
 		case EFFECT_CMD_SET_AUDIO_MODE:
 			break;
@@ -156,6 +324,14 @@ int32_t Effect::command(uint32_t cmdCode, uint32_t __attribute__((unused))cmdSiz
 			break;
 		}
 
+		/* No reply. The command is the file descriptor to print to. */
+		case EFFECT_CMD_DUMP:
+			if (pCmdData != NULL && cmdSize >= sizeof(uint32_t)) {
+				cpuDump(*(uint32_t *) pCmdData);
+				mStats.dump(*(uint32_t *) pCmdData, mSamplingRate);
+			}
+			break;
+
 		case EFFECT_CMD_SET_VOLUME:
 			if (pReplyData != NULL) {
 				int32_t *replyData = (int32_t *) pReplyData;
@@ -6,61 +6,91 @@
 #include "system/audio.h"
 #include "hardware/audio_effect.h"
 
+#include "EffectStats.h"
+#include "EffectTrace.h"
+#include "ParameterBuffer.h"
+#include "Pcm.h"
+
+/* Up to 7.1.4 */
+#define EFFECT_MAX_CHANNELS 12
+
+/* Frames per block pass of the default process(). */
+#define EFFECT_BLOCK 256
+
 class Effect {
 	private:
 	effect_buffer_access_e mAccessMode;
+	double mPlanes[EFFECT_MAX_CHANNELS][EFFECT_BLOCK];
+	EffectStats mStats;
+	EffectTrace mTrace;
 
 	protected:
 	bool mEnable;
 	double mSamplingRate;
-	int8_t formatFloatModeInt32Mode;
-	uint8_t mPreviousRandom;
-
-	/* High-passed triangular probability density function.
-	 * Output varies from -0xff to 0xff.
-	 * Support for 8.0 or lower android system */
-	inline int32_t triangularDither8() {
-		// srand((unsigned int)time(NULL));
-		uint8_t newRandom = rand() % 256;
-		int32_t rnd = int32_t(mPreviousRandom) - int32_t(newRandom);
-		mPreviousRandom = newRandom;
-		return rnd;
-	}
+	int32_t mChannels;
+	audio_format_t mInputFormat;
+	audio_format_t mOutputFormat;
+	PcmDither mDither;
 
-	/* AudioFlinger only gives us 16-bit PCM for now. */
-	inline double read(audio_buffer_t *in, int32_t idx) {
-		return (double)in->s16[idx] * 256.0;
-	}
-	
-	/* Android 9 use PCM_FLOAT input/output. so we make a method to read 
-	 * input buffer correctly. */
-	inline double readPcmFloat(audio_buffer_t *in, int32_t idx) {
-		return double(in->f32[idx] * 1e6);
-	}
-	
-	/* Android 9 use PCM_FLOAT input/output. so we make a method to write
-	 * output buffer correctly. */
-	inline void writePcmFloat(audio_buffer_t *out, int32_t idx, double sample) {
-		out->f32[idx] = float(sample / 1e6);
-	}
+	/* True while command() handles an EFFECT_CMD_SET_PARAM_DEFERRED:
+	 * the new values are staged but reach process() only with the next
+	 * EFFECT_CMD_SET_PARAM_COMMIT. */
+	bool mDeferParameters;
 
-	/* AudioFlinger only expects 16-bit PCM for now. */
-	inline void write(audio_buffer_t *out, int32_t idx, double sample) {
-		sample = (sample + (double)triangularDither8()) / 256;
-		if (sample > 32767) {
-			sample = 32767;
-		}
-		if (sample < -32768) {
-			sample = -32768;
+	/* SET_PARAM handlers publish through this instead of publish(). */
+	template <typename T>
+	void publishParameters(ParameterBuffer<T>& parameters)
+	{
+		if (!mDeferParameters) {
+			parameters.publish();
 		}
-		out->s16[idx] = (int16_t)sample;
 	}
 
+	/* Publishes the values staged by deferred SET_PARAMs, all at once. */
+	virtual void commitParameters();
+
+	/* Deinterleave / interleave frames [first, first + frames) of all
+	 * mChannels channels into planar arrays at PCM_FULL_SCALE, see Pcm.h.
+	 * Channel 0 and 1 are front left and right in every layout. */
+	void readPlanes(audio_buffer_t *in, uint32_t first, double* const* planes, int32_t frames);
+	void writePlanes(audio_buffer_t *out, uint32_t first, const double* const* planes, int32_t frames);
+#ifdef DSP_FIXED_POINT
+	void readPlanes(audio_buffer_t *in, uint32_t first, int32_t* const* planes, int32_t frames);
+	void writePlanes(audio_buffer_t *out, uint32_t first, const int32_t* const* planes, int32_t frames);
+#endif
+
 	int32_t configure(void *pCmdData);
 
 	public:
 	Effect();
 	virtual ~Effect();
-	virtual int32_t process(audio_buffer_t *in, audio_buffer_t *out) = 0;
+
+	/* Returns a released instance to the state of a new one, keeping
+	 * its buffers, so that EffectPool can hand it out again. */
+	virtual void recycle();
+
+	/* Entry point from the library: runs process() and counts the
+	 * call in the statistics printed by EFFECT_CMD_DUMP. */
+	int32_t processBuffer(audio_buffer_t *in, audio_buffer_t *out);
+
+	/* Entry point from the library: answers the trace commands of
+	 * EffectTrace.h, labelling the JSON trace with name, and passes
+	 * the others to command(), counting those that change what
+	 * process() does. */
+	int32_t handleCommand(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData, const char* name);
+
+	/* Converts the buffer to planes block by block and runs
+	 * processPlanes() on each. */
+	virtual int32_t process(audio_buffer_t *in, audio_buffer_t *out);
+
+	/* Processes mChannels planar channels at PCM_FULL_SCALE in place, any
+	 * number of frames. Returns 0 while there is output, -ENODATA once
+	 * the effect is disabled and can be bypassed. EffectChain runs
+	 * several effects on one buffer through this. */
+	virtual int32_t processPlanes(double* const* planes, int32_t frames) = 0;
+
+	/* Gain or loudness in dB that best shows what the effect is doing,
+	 * stored with each call in the trace. Audio thread. */
+	virtual float getTraceState();
 	virtual int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData) = 0;
 };
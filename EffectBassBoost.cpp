@@ -39,9 +39,30 @@ typedef struct {
 } reply1x4_1x2_t;
 
 EffectBassBoost::EffectBassBoost()
-	: mStrength(0), mCenterFrequency(55.0)
 {
-	refreshStrength();
+	setDefaults();
+}
+
+void EffectBassBoost::recycle()
+{
+	Effect::recycle();
+	setDefaults();
+}
+
+void EffectBassBoost::setDefaults()
+{
+	BassBoostParameters parameters;
+	parameters.strength = 0;
+	parameters.centerFrequency = 55.0;
+	designBoost(parameters);
+	mParameters.reset(parameters);
+	mBoost = Biquad();
+	mBoost.setFrom(0, parameters.coefficients);
+}
+
+void EffectBassBoost::commitParameters()
+{
+	mParameters.publish();
 }
 
 int32_t EffectBassBoost::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData)
@@ -54,6 +75,9 @@ int32_t EffectBassBoost::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 			return 0;
 		}
 
+		designBoost(mParameters.edit());
+		mParameters.publish();
+
 		int32_t *replyData = (int32_t *) pReplyData;
 		*replyData = 0;
 		return 0;
@@ -75,7 +99,7 @@ int32_t EffectBassBoost::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 				reply1x4_1x2_t *replyData = (reply1x4_1x2_t *) pReplyData;
 				replyData->status = 0;
 				replyData->vsize = 2;
-				replyData->data = mStrength;
+				replyData->data = mParameters.edit().strength;
 				*replySize = sizeof(reply1x4_1x2_t);
 				return 0;
 			}
@@ -83,7 +107,7 @@ int32_t EffectBassBoost::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 				reply1x4_1x2_t *replyData = (reply1x4_1x2_t *) pReplyData;
 				replyData->status = 0;
 				replyData->vsize = 2;
-				replyData->data = (int16_t) mCenterFrequency;
+				replyData->data = (int16_t) mParameters.edit().centerFrequency;
 				*replySize = sizeof(reply1x4_1x2_t);
 				return 0;
 			}
@@ -105,21 +129,23 @@ int32_t EffectBassBoost::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 		if (cep->psize == 4 && cep->vsize == 2) {
 			int32_t cmd = ((int32_t *) cep)[3];
 			if (cmd == BASSBOOST_PARAM_STRENGTH) {
-				mStrength = ((int16_t *) cep)[8];
+				mParameters.edit().strength = ((int16_t *) cep)[8];
+				designBoost(mParameters.edit());
+				publishParameters(mParameters);
 #ifdef DEBUG
-				ALOGI("New strength: %d", mStrength);
+				ALOGI("New strength: %d", mParameters.edit().strength);
 #endif
-				refreshStrength();
 				int32_t *replyData = (int32_t *) pReplyData;
 				*replyData = 0;
 				return 0;
 			}
 			if (cmd == 133) {
-				mCenterFrequency = ((int16_t* )cep)[8];
+				mParameters.edit().centerFrequency = ((int16_t* )cep)[8];
+				designBoost(mParameters.edit());
+				publishParameters(mParameters);
 #ifdef DEBUG
-				ALOGI("New center freq: %d", mCenterFrequency);
+				ALOGI("New center freq: %f", mParameters.edit().centerFrequency);
 #endif
-				refreshStrength();
 				int32_t *replyData = (int32_t *) pReplyData;
 				*replyData = 0;
 				return 0;
@@ -138,35 +164,35 @@ int32_t EffectBassBoost::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 	return Effect::command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
 }
 
-void EffectBassBoost::refreshStrength()
+/* Runs on the command thread, so that process() only copies the
+ * coefficients. */
+void EffectBassBoost::designBoost(BassBoostParameters& parameters)
 {
 	/* Q = 0.5 .. 2.0 */
-	mBoost.setLowPass(0, mCenterFrequency, mSamplingRate, 0.5 + mStrength / 666.0);
+	Biquad design;
+	design.setLowPass(0, parameters.centerFrequency, mSamplingRate, 0.5 + parameters.strength / 666.0);
+	design.getCoefficients(parameters.coefficients);
 }
 
-int32_t EffectBassBoost::process(audio_buffer_t* in, audio_buffer_t* out)
+int32_t EffectBassBoost::processPlanes(double* const* planes, int32_t frames)
 {
-	double dryL = 0.0, dryR = 0.0;
-	for (uint32_t i = 0; i < in->frameCount; i ++) {
+	if (mParameters.consume()) {
+		mBoost.setFrom(0, mParameters.current().coefficients);
+	}
 
-		if (formatFloatModeInt32Mode == 0) {
-			dryL = read(in, i << 1);
-			dryR = read(in, (i << 1) + 1);
-		}
-		else if (formatFloatModeInt32Mode == 1) {
-			dryL = readPcmFloat(in, i << 1);
-			dryR = readPcmFloat(in, (i << 1) + 1);
-		}
-		else if (formatFloatModeInt32Mode == 2) {
-			dryL = (double)in->s32[i << 1];
-			dryR = (double)in->s32[(i << 1) + 1];
-		}
+	/* The boost is a mono mix scaled so that stereo keeps its original
+	 * L + R level, whatever the channel count. */
+	double mix = 2.0 / mChannels;
+
+	double boost[BASSBOOST_BLOCK];
+	for (int32_t start = 0; start < frames; start += BASSBOOST_BLOCK) {
+		int32_t n = frames - start < BASSBOOST_BLOCK ? frames - start : BASSBOOST_BLOCK;
 
 		/* Original LVM effect was far more involved than this one.
 		* This effect is mostly a placeholder until I port that, or
 		* something else. LVM process diagram was as follows:
 		*
-		* in -> [ HPF ] -+-> [ mono mix ] -> [ BPF ] -> [ compressor ] -> out
+		* in -> [ HPF ] -+-> [ mono mix ] -> [ BPF ] -> [ compressor ] -> out
 		*                `-->------------------------------>--'
 		*
 		* High-pass filter was optional, and seemed to be
@@ -176,24 +202,26 @@ int32_t EffectBassBoost::process(audio_buffer_t* in, audio_buffer_t* out)
 		* Additionally, a compressor element was used to limit the
 		* mixing of the boost (only!) to avoid clipping.
 		*/
-		 
-		double boost = mBoost.process(dryL + dryR);
-
-        
-		if (formatFloatModeInt32Mode == 0) {
-			write(out, i << 1, dryL + boost);
-			write(out, (i << 1) + 1, dryR + boost);
+		for (int32_t i = 0; i < n; i ++) {
+			boost[i] = planes[0][start + i] + planes[1][start + i];
 		}
-		else if (formatFloatModeInt32Mode == 1) {
-			writePcmFloat(out, i << 1, dryL + boost);
-			writePcmFloat(out, (i << 1) + 1, dryR + boost);
+		for (int32_t c = 2; c < mChannels; c ++) {
+			for (int32_t i = 0; i < n; i ++) {
+				boost[i] += planes[c][start + i];
+			}
 		}
-		else if (formatFloatModeInt32Mode == 2) {
-			out->s32[i << 1] = (int32_t)(dryL + boost);
-			out->s32[(i << 1) + 1] = (int32_t)(dryL + boost);
+		if (mChannels != 2) {
+			for (int32_t i = 0; i < n; i ++) {
+				boost[i] *= mix;
+			}
+		}
+		mBoost.process(boost, boost, n);
+		for (int32_t c = 0; c < mChannels; c ++) {
+			for (int32_t i = 0; i < n; i ++) {
+				planes[c][start + i] += boost[i];
+			}
 		}
-
 	}
 
-    return mEnable ? 0 : -ENODATA;
+	return mEnable ? 0 : -ENODATA;
 }
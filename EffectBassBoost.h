@@ -4,18 +4,31 @@
 
 #include "Biquad.h"
 #include "Effect.h"
+#include "ParameterBuffer.h"
+
+/* Frames per block pass in processPlanes(). */
+#define BASSBOOST_BLOCK 256
+
+struct BassBoostParameters {
+	int16_t strength;
+	double centerFrequency;
+	/* Designed by command(), see Biquad::getCoefficients() */
+	double coefficients[5];
+};
 
 class EffectBassBoost : public Effect {
 	private:
-	int16_t mStrength;
-	double mCenterFrequency;
+	ParameterBuffer<BassBoostParameters> mParameters;
 	Biquad mBoost;
 
-	void refreshStrength();
+	void setDefaults();
+	void designBoost(BassBoostParameters& parameters);
+	void commitParameters();
 
 	public:
 	EffectBassBoost();
+	void recycle();
 
 	int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData);
-	int32_t process(audio_buffer_t *in, audio_buffer_t *out);
+	int32_t processPlanes(double* const* planes, int32_t frames);
 };
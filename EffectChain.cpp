@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef DEBUG
+#define LOG_TAG "Effect-Chain"
+
+#include <log/log.h>
+#endif
+
+#include <string.h>
+
+#include "EffectChain.h"
+
+EffectChain::EffectChain()
+{
+	mStage[CHAIN_STAGE_COMPRESSION] = &mCompression;
+	mStage[CHAIN_STAGE_EQUALIZER] = &mEqualizer;
+	mStage[CHAIN_STAGE_BASSBOOST] = &mBassBoost;
+	mStage[CHAIN_STAGE_VIRTUALIZER] = &mVirtualizer;
+	setDefaults();
+}
+
+void EffectChain::recycle()
+{
+	Effect::recycle();
+	for (int32_t i = 0; i < CHAIN_STAGES; i ++) {
+		mStage[i]->recycle();
+	}
+	setDefaults();
+}
+
+void EffectChain::setDefaults()
+{
+	ChainParameters parameters;
+	for (int32_t i = 0; i < CHAIN_STAGES; i ++) {
+		parameters.enabled[i] = false;
+		mActive[i] = false;
+	}
+	mParameters.reset(parameters);
+}
+
+int32_t EffectChain::setStageEnable(int32_t stage, bool enable)
+{
+	int32_t reply = 0;
+	uint32_t replySize = sizeof(reply);
+	mStage[stage]->command(enable ? EFFECT_CMD_ENABLE : EFFECT_CMD_DISABLE, 0, NULL, &replySize, &reply);
+
+	/* Never deferred: the stage has already seen its ENABLE / DISABLE. */
+	mParameters.edit().enabled[stage] = enable;
+	mParameters.publish();
+	return reply;
+}
+
+/* Strips the stage from { stage, param ... } and hands the rest to the
+ * stage as its own effect_param_t. GET_PARAM replies are mapped back
+ * the same way. */
+int32_t EffectChain::forwardParam(uint32_t cmdCode, effect_param_t* cep, uint32_t* replySize, void* pReplyData)
+{
+	int32_t stage = cep->psize >= 8 ? ((int32_t *) cep)[3] : -1;
+	uint32_t valueOffset = (cep->psize + 3) & ~3;
+	uint32_t childPsize = cep->psize - 4;
+	uint32_t childValueOffset = (childPsize + 3) & ~3;
+	uint32_t childSize = sizeof(effect_param_t) + childValueOffset + cep->vsize;
+
+	if (stage < 0 || stage >= CHAIN_STAGES || childSize > CHAIN_PARAM_MAX) {
+#ifdef DEBUG
+		ALOGE("Invalid chain parameter of %d bytes", cep->psize);
+#endif
+		if (cmdCode == EFFECT_CMD_GET_PARAM) {
+			effect_param_t *replyData = (effect_param_t *) pReplyData;
+			replyData->status = -EINVAL;
+			replyData->vsize = 0;
+			*replySize = sizeof(effect_param_t);
+		} else {
+			int32_t *replyData = (int32_t *) pReplyData;
+			*replyData = -EINVAL;
+		}
+		return 0;
+	}
+
+	int32_t cmd = ((int32_t *) cep)[4];
+	if (cmd == CHAIN_PARAM_STAGE_ENABLE && cep->psize == 8) {
+		if (cmdCode == EFFECT_CMD_GET_PARAM) {
+			effect_param_t *replyData = (effect_param_t *) pReplyData;
+			replyData->status = 0;
+			replyData->vsize = 2;
+			*(int16_t *) (replyData->data + 8) = mParameters.edit().enabled[stage] ? 1 : 0;
+			*replySize = sizeof(effect_param_t) + 8 + 2;
+			return 0;
+		}
+
+		int32_t *replyData = (int32_t *) pReplyData;
+		if (cep->vsize != 2) {
+			*replyData = -EINVAL;
+			return 0;
+		}
+		*replyData = setStageEnable(stage, *(int16_t *) (cep->data + 8) != 0);
+		return 0;
+	}
+
+	uint32_t command[CHAIN_PARAM_MAX / 4];
+	effect_param_t *child = (effect_param_t *) command;
+	child->status = 0;
+	child->psize = childPsize;
+	child->vsize = cep->vsize;
+	memcpy(child->data, cep->data + 4, childPsize);
+	memcpy(child->data + childValueOffset, cep->data + valueOffset, cep->vsize);
+
+	if (cmdCode == EFFECT_CMD_SET_PARAM) {
+		/* Deferred parameters stay deferred in the stage. */
+		uint32_t stageCode = mDeferParameters ? (uint32_t) EFFECT_CMD_SET_PARAM_DEFERRED : cmdCode;
+		return mStage[stage]->command(stageCode, childSize, child, replySize, pReplyData);
+	}
+
+	/* GET_PARAM replies start out as a copy of the command. */
+	uint32_t reply[CHAIN_PARAM_MAX / 4];
+	uint32_t childReplySize = sizeof(reply);
+	memcpy(reply, command, childSize);
+	mStage[stage]->command(cmdCode, childSize, child, &childReplySize, reply);
+
+	effect_param_t *childReply = (effect_param_t *) reply;
+	effect_param_t *replyData = (effect_param_t *) pReplyData;
+	uint32_t vsize = childReply->vsize;
+	if (childValueOffset + vsize > CHAIN_PARAM_MAX - sizeof(effect_param_t)
+			|| sizeof(effect_param_t) + valueOffset + vsize > *replySize) {
+		replyData->status = -EINVAL;
+		replyData->vsize = 0;
+		*replySize = sizeof(effect_param_t);
+		return 0;
+	}
+	replyData->status = childReply->status;
+	replyData->psize = cep->psize;
+	replyData->vsize = vsize;
+	memcpy(replyData->data, &stage, 4);
+	memcpy(replyData->data + 4, childReply->data, childPsize);
+	memcpy(replyData->data + valueOffset, childReply->data + childValueOffset, vsize);
+	*replySize = sizeof(effect_param_t) + valueOffset + vsize;
+	return 0;
+}
+
+/* Deferred parameters are held by the stages themselves. */
+void EffectChain::commitParameters()
+{
+	for (int32_t i = 0; i < CHAIN_STAGES; i ++) {
+		int32_t reply = 0;
+		uint32_t replySize = sizeof(reply);
+		mStage[i]->command(EFFECT_CMD_SET_PARAM_COMMIT, 0, NULL, &replySize, &reply);
+	}
+	mParameters.publish();
+}
+
+int32_t EffectChain::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData)
+{
+	if (cmdCode == EFFECT_CMD_SET_CONFIG) {
+		int32_t *replyData = (int32_t *) pReplyData;
+		int32_t ret = Effect::configure(pCmdData);
+		for (int32_t i = 0; i < CHAIN_STAGES && ret == 0; i ++) {
+			uint32_t stageReplySize = sizeof(ret);
+			mStage[i]->command(cmdCode, cmdSize, pCmdData, &stageReplySize, &ret);
+		}
+		*replyData = ret;
+		return 0;
+	}
+
+	if (cmdCode == EFFECT_CMD_GET_PARAM || cmdCode == EFFECT_CMD_SET_PARAM) {
+		return forwardParam(cmdCode, (effect_param_t *) pCmdData, replySize, pReplyData);
+	}
+
+	/* Only compression follows the stream volume. */
+	if (cmdCode == EFFECT_CMD_SET_VOLUME) {
+		return mCompression.command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+	}
+
+	return Effect::command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+}
+
+int32_t EffectChain::processPlanes(double* const* planes, int32_t frames)
+{
+	bool consumed = mParameters.consume();
+	const bool* enabled = mParameters.current().enabled;
+	if (consumed) {
+		for (int32_t i = 0; i < CHAIN_STAGES; i ++) {
+			if (enabled[i]) {
+				mActive[i] = true;
+			}
+		}
+	}
+
+	/* A disabled stage keeps running until it has faded out. */
+	for (int32_t i = 0; i < CHAIN_STAGES; i ++) {
+		if (mActive[i]) {
+			mActive[i] = mStage[i]->processPlanes(planes, frames) == 0 || enabled[i];
+		}
+	}
+
+	return mEnable ? 0 : -ENODATA;
+}
+
+/* The compressor's gain, the stage that changes level the most */
+float EffectChain::getTraceState()
+{
+	return mActive[CHAIN_STAGE_COMPRESSION] ? mCompression.getTraceState() : 0.0f;
+}
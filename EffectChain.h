@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Effect.h"
+#include "EffectBassBoost.h"
+#include "EffectCompression.h"
+#include "EffectEqualizer.h"
+#include "EffectVirtualizer.h"
+#include "ParameterBuffer.h"
+
+/* Stages, in processing order. Parameters of the chain carry the stage in
+ * front of the hosted effect's own parameter, { stage, param ... }, with
+ * the value unchanged, so every existing parameter is available. */
+#define CHAIN_STAGE_COMPRESSION 0
+#define CHAIN_STAGE_EQUALIZER 1
+#define CHAIN_STAGE_BASSBOOST 2
+#define CHAIN_STAGE_VIRTUALIZER 3
+#define CHAIN_STAGES 4
+
+/* { stage, CHAIN_PARAM_STAGE_ENABLE }, int16 value 0 or 1: enables or
+ * disables one stage, like EFFECT_CMD_ENABLE / DISABLE on its own.
+ * Applied at once, also when sent with EFFECT_CMD_SET_PARAM_DEFERRED. */
+#define CHAIN_PARAM_STAGE_ENABLE 0x10000
+
+/* Largest forwarded effect_param_t, header included */
+#define CHAIN_PARAM_MAX 256
+
+/* Stage enables, set by command() and applied by process() at the next
+ * buffer. */
+struct ChainParameters {
+	bool enabled[CHAIN_STAGES];
+};
+
+/* Compression, EQ, bass boost and virtualizer as one insert effect. The
+ * buffer is converted to planes once, every enabled stage runs on the
+ * shared planes, and the result is converted back once. */
+class EffectChain : public Effect {
+	private:
+	EffectCompression mCompression;
+	EffectEqualizer mEqualizer;
+	EffectBassBoost mBassBoost;
+	EffectVirtualizer mVirtualizer;
+	Effect* mStage[CHAIN_STAGES];
+
+	/* Enabled by the client, and still producing output */
+	ParameterBuffer<ChainParameters> mParameters;
+	bool mActive[CHAIN_STAGES];
+
+	void setDefaults();
+	int32_t setStageEnable(int32_t stage, bool enable);
+	int32_t forwardParam(uint32_t cmdCode, effect_param_t* cep, uint32_t* replySize, void* pReplyData);
+	void commitParameters();
+
+	public:
+	EffectChain();
+	void recycle();
+	int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData);
+	int32_t processPlanes(double* const* planes, int32_t frames);
+	float getTraceState();
+};
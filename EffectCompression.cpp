@@ -21,22 +21,130 @@
 #endif
 
 #include "EffectCompression.h"
+#include "FastMath.h"
 
 #include <cmath>
+#include <string.h>
 
+EffectCompression::EffectCompression()
+{
+	setDefaults();
+}
 
-static int32_t max(int32_t a, int32_t b)
+void EffectCompression::recycle()
 {
-	return a > b ? a : b;
+	Effect::recycle();
+	setDefaults();
 }
 
-EffectCompression::EffectCompression()
-	: mCompressionRatio(2.0), mFade(0)
+void EffectCompression::setDefaults()
 {
-	for (int32_t i = 0; i < 2; i ++) {
+	mEnableCount = 0;
+	mFade = 0;
+	mControlInterval = 1;
+	mControlCounter = 0;
+	mDetectorCoeff = 1.0;
+	mBands = 1;
+	mWeigher = BiquadBank();
+	mCrossover = Crossover();
+
+	CompressionParameters parameters;
+	parameters.userLevel[0] = 1 << 24;
+	parameters.userLevel[1] = 1 << 24;
+	parameters.ratio = 2.0;
+	parameters.bands = 1;
+	parameters.enableCount = 0;
+	mParameters.reset(parameters);
+
+	v4df zero = { 0, 0, 0, 0 };
+	for (int32_t i = 0; i < EFFECT_MAX_CHANNELS; i ++) {
+		mDetector[i] = LevelDetector();
 		mCurrentLevel[i] = 0;
-		mUserLevel[i] = 1 << 24;
+		mVolAdj[i] = 0;
+		mBandSubPower[i] = zero;
+		mBandPower[i] = zero;
+		mBandLevel[i] = zero;
+		mBandAdj[i] = zero;
+	}
+}
+
+void EffectCompression::setBands(int32_t bands)
+{
+	static const double threeBands[] = { 250.0, 2500.0 };
+	static const double fourBands[] = { 120.0, 800.0, 5000.0 };
+
+	mCrossover.setBands(bands, bands == 3 ? threeBands : fourBands, mSamplingRate);
+
+	/* Carry the running gain and level over, so that switching modes
+	 * does not restart the fade in. */
+	if (bands != mBands) {
+		for (int32_t i = 0; i < EFFECT_MAX_CHANNELS; i ++) {
+			if (bands == 1) {
+				double level = 0, power = 0;
+				for (int32_t j = 0; j < mBands; j ++) {
+					level += mBandLevel[i][j] / mBands;
+					power += mBandPower[i][j];
+				}
+				mCurrentLevel[i] = int32_t(level * 16777216.0);
+				mDetector[i].setLevel(power);
+				mVolAdj[i] = 0;
+			} else {
+				double level = mBands == 1 ? mCurrentLevel[i] / 16777216.0 : mBandLevel[i][0];
+				double power = mBands == 1 ? mDetector[i].getLevel() : mBandPower[i][0] + mBandPower[i][1] + mBandPower[i][2] + mBandPower[i][3];
+				for (int32_t j = 0; j < CROSSOVER_MAX_BANDS; j ++) {
+					mBandLevel[i][j] = j < bands ? level : 0.0;
+					mBandPower[i][j] = j < bands ? power / bands : 0.0;
+					mBandAdj[i][j] = 0;
+					mBandSubPower[i][j] = 0;
+				}
+			}
+		}
+	}
+	mBands = bands;
+}
+
+/* The host sets left and right volumes only; the other channels follow
+ * their average. */
+int32_t EffectCompression::userLevel(int32_t channel) const
+{
+	const int32_t* level = mParameters.current().userLevel;
+	if (channel < 2) {
+		return level[channel];
 	}
+	return (level[0] >> 1) + (level[1] >> 1);
+}
+
+/* Audio thread: takes the newest parameters at a buffer boundary. A band
+ * count change rebuilds the crossover here, between buffers, rather than
+ * under a running process(). */
+void EffectCompression::consumeParameters()
+{
+	if (!mParameters.consume()) {
+		return;
+	}
+
+	const CompressionParameters& parameters = mParameters.current();
+	if (parameters.bands != mBands) {
+		setBands(parameters.bands);
+	}
+
+	/* Unfortunately Android calls SET_VOLUME after ENABLE for us.
+	 * so we can't really use those volumes. It's safest just to fade in
+	 * each time. */
+	if (parameters.enableCount != mEnableCount) {
+		mEnableCount = parameters.enableCount;
+		for (int32_t i = 0; i < EFFECT_MAX_CHANNELS; i ++) {
+			mCurrentLevel[i] = 0;
+			for (int32_t j = 0; j < CROSSOVER_MAX_BANDS; j ++) {
+				mBandLevel[i][j] = 0;
+			}
+		}
+	}
+}
+
+void EffectCompression::commitParameters()
+{
+	mParameters.publish();
 }
 
 int32_t EffectCompression::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData)
@@ -51,8 +159,27 @@ int32_t EffectCompression::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 
 	/* This filter gives a reasonable approximation of A- and C-weighting
 	 * which is close to correct for 100 - 10 kHz. 10 dB gain must be added to result. */
-	mWeigherBP[0].setBandPass(0, 2200, mSamplingRate, 0.33);
-	mWeigherBP[1].setBandPass(0, 2200, mSamplingRate, 0.33);
+	Biquad weigher;
+	weigher.setBandPass(0, 2200, mSamplingRate, 0.33);
+	mWeigher.setSize(mChannels, 1);
+	for (int32_t i = 0; i < mChannels; i ++) {
+		mWeigher.setFilter(i, 0, 0, weigher);
+	}
+
+	mControlInterval = int32_t(mSamplingRate * COMPRESSION_CONTROL_MS / 1000);
+	if (mControlInterval < 1) {
+		mControlInterval = 1;
+	}
+	mControlCounter = 0;
+	mDetectorCoeff = 1.0 - exp(-1.0 * COMPRESSION_CONTROL_MS / COMPRESSION_DETECTOR_MS);
+	for (int32_t i = 0; i < EFFECT_MAX_CHANNELS; i ++) {
+		mDetector[i].setFullScale(PCM_FULL_SCALE);
+		mDetector[i].setSmoothing(mDetectorCoeff);
+		for (int32_t j = 0; j < CROSSOVER_MAX_BANDS; j ++) {
+			mBandSubPower[i][j] = 0;
+		}
+	}
+	setBands(mBands);
 
 	*replyData = 0;
 	return 0;
@@ -67,9 +194,23 @@ int32_t EffectCompression::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 			int32_t cmd = ((int32_t *)cep)[3];
 			if (cmd == 0) {
 				/* 1.0 .. 11.0 */
-				mCompressionRatio = 1.f + value / 100.f;
+				mParameters.edit().ratio = 1.f + value / 100.f;
+				publishParameters(mParameters);
+#ifdef DEBUG
+				ALOGI("Compression factor set to: %f", mParameters.edit().ratio);
+#endif
+				*replyData = 0;
+				return 0;
+			}
+			if (cmd == COMPRESSION_PARAM_BANDS) {
+				if (value != 1 && value != 3 && value != 4) {
+					*replyData = -EINVAL;
+					return 0;
+				}
+				mParameters.edit().bands = value;
+				publishParameters(mParameters);
 #ifdef DEBUG
-				ALOGI("Compression factor set to: %f", mCompressionRatio);
+				ALOGI("Compression bands set to: %d", value);
 #endif
 				*replyData = 0;
 				return 0;
@@ -93,7 +234,7 @@ int32_t EffectCompression::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 #ifdef DEBUG
 				ALOGI("user volume on channel %d: %d", i, userVols[i]);
 #endif
-				mUserLevel[i] = userVols[i];
+				mParameters.edit().userLevel[i] = userVols[i];
 			}
 
 			int32_t *myVols = (int32_t *) pReplyData;
@@ -106,9 +247,10 @@ int32_t EffectCompression::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 		} else {
 			/* We don't control volume. */
 			for (int32_t i = 0; i < 2; i ++) {
-				mUserLevel[i] = 1 << 24;
+				mParameters.edit().userLevel[i] = 1 << 24;
 			}
 		}
+		mParameters.publish();
 
 		return 0;
 	}
@@ -119,141 +261,280 @@ int32_t EffectCompression::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 #ifdef DEBUG
 		ALOGI("Copying user levels as initial loudness.");
 #endif
-		/* Unfortunately Android calls SET_VOLUME after ENABLE for us.
-		 * so we can't really use those volumes. It's safest just to fade in
-		 * each time. */
-		for (int32_t i = 0; i < 2; i ++) {
-			mCurrentLevel[i] = 0;
-		}
+		mParameters.edit().enableCount ++;
+		mParameters.publish();
 	}
 
 	return Effect::command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
 }
 
-/* Return fixed point 16.48 */
-uint64_t EffectCompression::estimateOneChannelLevel(audio_buffer_t *in, int32_t interleave, int32_t offset, Biquad& weigherBP)
+/* Gain that moves a measured power, relative to full scale, towards the
+ * target loudness. offsetDb calibrates the measurement to SPL. */
+double EffectCompression::correctionGain(double power, double offsetDb)
 {
-	uint64_t power = 0;
-	double tmp = 0.0;
-	for (uint32_t i = 0; i < in->frameCount; i ++) {
-		
-		if (formatFloatModeInt32Mode == 0) {
-			tmp = read(in, offset);
-		}
-		else if (formatFloatModeInt32Mode == 1) {
-			tmp = readPcmFloat(in, offset);
-		}
-		else if (formatFloatModeInt32Mode == 2) {
-			tmp = (double)in->s32[offset];
-		}
-		tmp = weigherBP.process(tmp);
-
-		/* 2^24 * 2^24 = 48 */
-		power += int64_t(tmp) * int64_t(tmp);
-		offset += interleave;
-	}
-
-	return (power / in->frameCount);
-}
-
-int32_t EffectCompression::process(audio_buffer_t *in, audio_buffer_t *out)
-{
-	/* Analyze both channels separately, pick the maximum power measured. */
-	uint64_t maximumPowerSquared = 0;
-	for (uint32_t i = 0; i < 2; i ++) {
-		uint64_t candidatePowerSquared = estimateOneChannelLevel(in, 2, i, mWeigherBP[i]);
-		if (candidatePowerSquared > maximumPowerSquared) {
-			maximumPowerSquared = candidatePowerSquared;
-		}
-	}
-
 	/* -100 .. 0 dB. */
-	double signalPowerDb = log10(maximumPowerSquared / double(int64_t(1) << 48) + 1e-10) * 10.0;
+	double signalPowerDb = fastDb(power + 1e-10);
 
-	/* Target 83 dB SPL */
-	signalPowerDb += 96.0 - 83.0 + 10.0;
+	/* Target 83 dB SPL. The calibration predates full scale relative
+	 * detection and counted from 2^48, 6 dB above s16 full scale power. */
+	signalPowerDb += 96.0 - 6.0206 - 83.0 + offsetDb;
 
 	/* now we have an estimate of the signal power, with 0 level around 83 dB.
 	* we now select the level to boost to. */
-	double desiredLevelDb = signalPowerDb / mCompressionRatio;
+	double desiredLevelDb = signalPowerDb / mParameters.current().ratio;
 
 	/* turn back to multiplier */
 	double correctionDb = desiredLevelDb - signalPowerDb;
 
-	if (mEnable && mFade != 100) {
+	correctionDb *= mFade / double(COMPRESSION_FADE_STEPS);
+
+	/* Reduce extreme boost by a smooth ramp.
+	 * New range -50 .. 0 dB */
+	double ramp = correctionDb / 100;
+	correctionDb -= ramp * ramp * (100.0 / 2.0);
+
+	return fastDbToGain(correctionDb);
+}
+
+/* Runs once per control interval. The detector and the gain target are
+ * both advanced on this fixed clock, so the dynamics do not depend on how
+ * the host slices the stream into buffers. */
+void EffectCompression::updateGain()
+{
+	if (mEnable && mFade != COMPRESSION_FADE_STEPS) {
 		mFade += 1;
 	}
 	if (!mEnable && mFade != 0) {
 		mFade -= 1;
 	}
 
-	correctionDb *= mFade / 100.0;
+	/* I want volume adjustments to occur in about 0.025 seconds.
+	 * Retargeting every interval turns this into a close piecewise
+	 * linear approximation of an exponential approach. */
+	int32_t adjLen = mSamplingRate / 48; // in practice, about 1000 frames
+
+	double scale = 1.0 / (mControlInterval * PCM_FULL_SCALE * PCM_FULL_SCALE);
+
+	if (mBands != 1) {
+		/* The split stands in for the loudness weighting. */
+		double broadbandPower = 0;
+		for (int32_t i = 0; i < mChannels; i ++) {
+			double power = 0;
+			for (int32_t j = 0; j < CROSSOVER_MAX_BANDS; j ++) {
+				mBandPower[i][j] += (mBandSubPower[i][j] * scale - mBandPower[i][j]) * mDetectorCoeff;
+				mBandSubPower[i][j] = 0;
+				power += mBandPower[i][j];
+			}
+			if (power > broadbandPower) {
+				broadbandPower = power;
+			}
+		}
+
+		/* The bands share one broadband correction, so that the balance
+		 * of the mix is kept. A band is only turned down further when it
+		 * is louder than its share of the target, which is 1 / mBands of
+		 * the power, and then by at most 10 log10(mBands) (1 - 1 / ratio)
+		 * dB: 2.4 dB for three bands at the default ratio. Quiet bands
+		 * are never lifted above the rest. */
+		double broadband = correctionGain(broadbandPower, 0.0);
+		double offsetDb = fastDb(mBands);
+		for (int32_t j = 0; j < mBands; j ++) {
+			/* Linked: every channel follows the loudest one. */
+			double maximumPower = 0;
+			for (int32_t i = 0; i < mChannels; i ++) {
+				if (mBandPower[i][j] > maximumPower) {
+					maximumPower = mBandPower[i][j];
+				}
+			}
+			double correction = correctionGain(maximumPower, offsetDb);
+			if (correction > broadband) {
+				correction = broadband;
+			}
+			for (int32_t i = 0; i < mChannels; i ++) {
+				double adj = (userLevel(i) / 16777216.0 * correction - mBandLevel[i][j]) / adjLen;
+				/* Increase slowly, as in broadband mode. */
+				mBandAdj[i][j] = adj > 0 ? adj / 16 : adj;
+			}
+		}
+		return;
+	}
 
-	/* Reduce extreme boost by a smooth ramp.
-	 * New range -50 .. 0 dB */
-	correctionDb -= pow(correctionDb / 100, 2.0) * (100.0 / 2.0);
+	/* Analyze all channels separately, pick the maximum power measured. */
+	double maximumPower = 0;
+	for (int32_t i = 0; i < mChannels; i ++) {
+		double power = mDetector[i].update();
+		if (power > maximumPower) {
+			maximumPower = power;
+		}
+	}
 
-	/* 40.24 */
-	int64_t correctionFactor = (1 << 24) * pow(10.0, correctionDb / 20.0);
+	/* 40.24; the weighting filter needs 10 dB added. */
+	int64_t correctionFactor = (1 << 24) * correctionGain(maximumPower, 10.0);
 
 	/* Now we have correction factor and user-desired sound level. */
-	double value = 0.0;
-	for (uint32_t i = 0; i < 2; i ++) {
+	for (int32_t i = 0; i < mChannels; i ++) {
 		/* 8.24 */
-		int32_t desiredLevel = mUserLevel[i] * correctionFactor >> 24;
+		int32_t desiredLevel = userLevel(i) * correctionFactor >> 24;
 
 		/* 8.24 */
-		int32_t volAdj = desiredLevel - mCurrentLevel[i];
-
-		/* I want volume adjustments to occur in about 0.025 seconds.
-		 * However, if the input buffer would happen to be longer than
-		 * this, I'll just make sure that I am done with the adjustment
-		 * by the end of it.
-		 */
-		int32_t adjLen = mSamplingRate / 48; // in practice, about 1100 frames
-		
-		/* This formulation results in piecewise linear approximation of
-		 * exponential because the rate of adjustment decreases from granule
-		 * to granule.
-		 */
-		volAdj /= max(adjLen, in->frameCount);
+		mVolAdj[i] = (desiredLevel - mCurrentLevel[i]) / adjLen;
 
 		/* Additionally, I want volume to increase only very slowly.
 		 * This biases us against pumping effects and also tends to spare
 		 * our ears when some very loud sound begins suddenly.
 		 */
-		if (volAdj > 0) {
-			volAdj >>= 4;
+		if (mVolAdj[i] > 0) {
+			mVolAdj[i] >>= 4;
 		}
+	}
+}
 
-		for (uint32_t j = 0; j < in->frameCount; j ++) {
-
-			if (formatFloatModeInt32Mode == 0) {
-				value = read(in, (j << 1) + i);
-			}
-			else if (formatFloatModeInt32Mode == 1) {
-				value = readPcmFloat(in, (j << 1) + i);
-			}
-			else if (formatFloatModeInt32Mode == 2) {
-				value = (double)in->s32[(j << 1) + i];
+/* Multiband counterpart of the gain loop in process(): split, detect and
+ * apply per band gains, and sum the bands back, for one block. Runs one
+ * control interval at a time so that every channel has been measured
+ * before the linked gain is updated. */
+void EffectCompression::processBands(sample_t* const* planes, int32_t frames)
+{
+	int32_t j = 0;
+	while (j < frames) {
+		int32_t count = mControlInterval - mControlCounter;
+		if (count > frames - j) {
+			count = frames - j;
+		}
+		mControlCounter += count;
+
+		for (int32_t c = 0; c < mChannels; c ++) {
+			sample_t* x = planes[c] + j;
+			mCrossover.process(c, x, mBandScratch, count);
+
+			v4df power = mBandSubPower[c];
+			v4df level = mBandLevel[c];
+			v4df adj = mBandAdj[c];
+			for (int32_t i = 0; i < count; i ++) {
+				v4df y = mBandScratch[i];
+				power += y * y;
+				y *= level;
+				x[i] = sample_t((y[0] + y[1]) + (y[2] + y[3]));
+				level += adj;
 			}
+			mBandSubPower[c] = power;
+			mBandLevel[c] = level;
+		}
+		j += count;
 
-			value = value * mCurrentLevel[i] / 16777216.0;
-             
-			 
-			if (formatFloatModeInt32Mode == 0) {
-				write(out, (j << 1) + i, value);
-			}
-			else if (formatFloatModeInt32Mode == 1) {
-				writePcmFloat(out, (j << 1) + i, value);
-			}
-			else if (formatFloatModeInt32Mode == 2) {
-				out->s32[(j << 1) + i] = (int32_t)value;
+		if (mControlCounter == mControlInterval) {
+			mControlCounter = 0;
+			updateGain();
+		}
+	}
+}
+
+/* Single pass over at most COMPRESSION_BLOCK frames: each block is
+ * analyzed and scaled while it is in cache. The gain slope changes only
+ * at control interval boundaries, which may fall anywhere in a block. */
+void EffectCompression::processSamples(sample_t* const* planes, int32_t frames)
+{
+	if (mBands != 1) {
+		processBands(planes, frames);
+		return;
+	}
+
+	sample_t* weighted[EFFECT_MAX_CHANNELS];
+	for (int32_t c = 0; c < mChannels; c ++) {
+		weighted[c] = mWeighted[c];
+		memcpy(weighted[c], planes[c], frames * sizeof(sample_t));
+	}
+	mWeigher.process(weighted, frames);
+
+	int32_t j = 0;
+	while (j < frames) {
+		int32_t count = mControlInterval - mControlCounter;
+		if (count > frames - j) {
+			count = frames - j;
+		}
+		mControlCounter += count;
+
+		for (int32_t c = 0; c < mChannels; c ++) {
+			mDetector[c].accumulate(weighted[c] + j, count);
+
+			sample_t* x = planes[c] + j;
+			int32_t level = mCurrentLevel[c];
+			int32_t adj = mVolAdj[c];
+			for (int32_t i = 0; i < count; i ++) {
+				x[i] = mulQ24(x[i], level);
+				level += adj;
 			}
+			mCurrentLevel[c] = level;
+		}
+		j += count;
+
+		if (mControlCounter == mControlInterval) {
+			mControlCounter = 0;
+			updateGain();
+		}
+	}
+}
 
-			mCurrentLevel[i] += volAdj;
+int32_t EffectCompression::processPlanes(double* const* planes, int32_t frames)
+{
+	consumeParameters();
+
+	sample_t* samples[EFFECT_MAX_CHANNELS];
+	for (int32_t start = 0; start < frames; start += COMPRESSION_BLOCK) {
+		int32_t n = frames - start < COMPRESSION_BLOCK ? frames - start : COMPRESSION_BLOCK;
+#ifdef DSP_FIXED_POINT
+		for (int32_t c = 0; c < mChannels; c ++) {
+			samples[c] = mPlanes[c];
+			samplesFromDouble(planes[c] + start, samples[c], n);
+		}
+		processSamples(samples, n);
+		for (int32_t c = 0; c < mChannels; c ++) {
+			samplesToDouble(samples[c], planes[c] + start, n);
 		}
+#else
+		for (int32_t c = 0; c < mChannels; c ++) {
+			samples[c] = planes[c] + start;
+		}
+		processSamples(samples, n);
+#endif
 	}
 
 	return mEnable || mFade != 0 ? 0 : -ENODATA;
 }
+
+#ifdef DSP_FIXED_POINT
+/* Standalone, the integer engine reads the PCM buffer directly. */
+int32_t EffectCompression::process(audio_buffer_t *in, audio_buffer_t *out)
+{
+	consumeParameters();
+
+	sample_t* planes[EFFECT_MAX_CHANNELS];
+	for (int32_t c = 0; c < mChannels; c ++) {
+		planes[c] = mPlanes[c];
+	}
+
+	for (uint32_t start = 0; start < in->frameCount; start += COMPRESSION_BLOCK) {
+		int32_t n = in->frameCount - start < COMPRESSION_BLOCK ? in->frameCount - start : COMPRESSION_BLOCK;
+
+		readPlanes(in, start, planes, n);
+		processSamples(planes, n);
+		writePlanes(out, start, planes, n);
+	}
+
+	return mEnable || mFade != 0 ? 0 : -ENODATA;
+}
+#endif
+
+/* Gain applied to the left channel */
+float EffectCompression::getTraceState()
+{
+	double level = 0.0;
+	if (mBands == 1) {
+		level = mCurrentLevel[0] / 16777216.0;
+	} else {
+		for (int32_t j = 0; j < mBands; j ++) {
+			level += mBandLevel[0][j] / mBands;
+		}
+	}
+	return float(20.0 * log10(fmax(level, 1e-5)));
+}
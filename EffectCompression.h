@@ -1,22 +1,89 @@
 #pragma once
 
 #include "Biquad.h"
+#include "BiquadBank.h"
+#include "Crossover.h"
 #include "Effect.h"
+#include "LevelDetector.h"
+#include "ParameterBuffer.h"
+
+/* Number of bands: 1 (broadband), 3 or 4 */
+#define COMPRESSION_PARAM_BANDS 1
+
+/* Frames per block pass in processSamples(). */
+#define COMPRESSION_BLOCK 256
+
+/* Gain is recomputed once per control interval of this many ms. */
+#define COMPRESSION_CONTROL_MS 1
+/* Level detector time constant */
+#define COMPRESSION_DETECTOR_MS 20
+/* Enable/disable fade, counted in control intervals */
+#define COMPRESSION_FADE_STEPS 2000
+
+/* Set by command(), applied by process() at the next buffer. */
+struct CompressionParameters {
+	int32_t userLevel[2];
+	float ratio;
+	int32_t bands;
+	/* Bumped by EFFECT_CMD_ENABLE to restart the fade in */
+	uint32_t enableCount;
+};
 
 class EffectCompression : public Effect {
 	private:
-	int32_t mUserLevel[2];
-	float mCompressionRatio;
+	ParameterBuffer<CompressionParameters> mParameters;
+	uint32_t mEnableCount;
 
 	int32_t mFade;
-	int32_t mCurrentLevel[2];
+	int32_t mCurrentLevel[EFFECT_MAX_CHANNELS];
+
+	/* Loudness weighting band pass, one per channel */
+	BiquadBank mWeigher;
+
+	/* Control rate state: frames per interval and frames seen in the
+	 * current one. */
+	int32_t mControlInterval;
+	int32_t mControlCounter;
+
+	/* Smoothed weighted power per channel */
+	LevelDetector mDetector[EFFECT_MAX_CHANNELS];
+	double mDetectorCoeff;
+
+	/* Per-frame gain slope, 8.24 */
+	int32_t mVolAdj[EFFECT_MAX_CHANNELS];
+
+	/* Multiband mode, one crossover band per lane. Levels and slopes
+	 * are plain gains, 1.0 is unity. */
+	int32_t mBands;
+	Crossover mCrossover;
+	v4df mBandSubPower[EFFECT_MAX_CHANNELS];
+	v4df mBandPower[EFFECT_MAX_CHANNELS];
+	v4df mBandLevel[EFFECT_MAX_CHANNELS];
+	v4df mBandAdj[EFFECT_MAX_CHANNELS];
+	v4df mBandScratch[COMPRESSION_BLOCK];
 
-	Biquad mWeigherBP[2];
+#ifdef DSP_FIXED_POINT
+	sample_t mPlanes[EFFECT_MAX_CHANNELS][COMPRESSION_BLOCK];
+#endif
+	sample_t mWeighted[EFFECT_MAX_CHANNELS][COMPRESSION_BLOCK];
 
-	uint64_t estimateOneChannelLevel(audio_buffer_t *in, int32_t interleave, int32_t offset, Biquad& WeigherBP);
+	void setDefaults();
+	void setBands(int32_t bands);
+	void consumeParameters();
+	int32_t userLevel(int32_t channel) const;
+	double correctionGain(double power, double offsetDb);
+	void updateGain();
+	void processBands(sample_t* const* planes, int32_t frames);
+	void processSamples(sample_t* const* planes, int32_t frames);
+	void commitParameters();
 
 	public:
 	EffectCompression();
+	void recycle();
 	int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData);
+	int32_t processPlanes(double* const* planes, int32_t frames);
+	float getTraceState();
+#ifdef DSP_FIXED_POINT
 	int32_t process(audio_buffer_t *in, audio_buffer_t *out);
+#endif
 };
@@ -80,14 +80,58 @@ typedef struct {
 } reply1x4_props_t;
 
 EffectEqualizer::EffectEqualizer()
-	: mLoudnessAdjustment(10000.0), mLoudnessL(50.0), mLoudnessR(50.0),
-		mNextUpdate(0), mNextUpdateInterval(1000), mPowerSquaredL(0.0), mPowerSquaredR(0.0), mFade(0)
 {
-	for (int32_t i = 0; i < 6; i ++) {
-		mBand[i] = 0;
+	setDefaults();
+
+#ifdef DSP_DESIGNER_THREAD
+	mDesigner = Designer::attach(this);
+#endif
+}
+
+#ifdef DSP_DESIGNER_THREAD
+EffectEqualizer::~EffectEqualizer()
+{
+	Designer::detach(this);
+}
+#endif
+
+void EffectEqualizer::recycle()
+{
+	Effect::recycle();
+#ifdef DSP_DESIGNER_THREAD
+	/* Nothing from the last session may land in the next one. */
+	Designer::cancel(this);
+	mDesignInput.reset(EqualizerDesignInput());
+	mDesign.reset(EqualizerDesign());
+#endif
+	setDefaults();
+}
+
+void EffectEqualizer::setDefaults()
+{
+	mNextUpdate = 0;
+	mNextUpdateInterval = 1000;
+	mFade = 0;
+	mFilters = BiquadBank();
+
+	EqualizerParameters parameters;
+	for (int32_t i = 0; i < NUM_BANDS; i ++) {
+		parameters.band[i] = 0;
+	}
+	parameters.loudnessAdjustment = 10000.0;
+	mParameters.reset(parameters);
+
+	for (int32_t i = 0; i < EFFECT_MAX_CHANNELS; i ++) {
+		mLoudness[i] = 50.0;
+		mDetector[i] = LevelDetector();
 	}
 }
 
+void EffectEqualizer::commitParameters()
+{
+	mParameters.publish();
+}
+
 int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData)
 {
 	if (cmdCode == EFFECT_CMD_SET_CONFIG) {
@@ -104,6 +148,12 @@ int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 		/* 100 updates per second. */
 		mNextUpdateInterval = int32_t(mSamplingRate / 100.0);
 
+		/* Plain mean over each update interval */
+		for (int32_t i = 0; i < EFFECT_MAX_CHANNELS; i ++) {
+			mDetector[i].setFullScale(PCM_FULL_SCALE);
+		}
+		mFilters.setSize(mChannels, NUM_BANDS - 1);
+
 		int32_t *replyData = (int32_t *) pReplyData;
 		*replyData = 0;
 		return 0;
@@ -145,7 +195,7 @@ int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 				replyData->data[0] = (int16_t)-1; // PRESET_CUSTOM
 				replyData->data[1] = (int16_t)6;  // number of bands
 				for (int i = 0; i < NUM_BANDS; i++) {
-					replyData->data[2 + i] = (int16_t)(mBand[i] * 100 + 0.5f); // band levels
+					replyData->data[2 + i] = (int16_t)(mParameters.edit().band[i] * 100 + 0.5f); // band levels
 				}
 				*replySize = sizeof(reply1x4_props_t);
 				return 0;
@@ -157,7 +207,7 @@ int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 				reply2x4_1x2_t *replyData = (reply2x4_1x2_t *) pReplyData;
 				replyData->status = 0;
 				replyData->vsize = 2;
-				replyData->data = int16_t(mBand[arg] * 100 + 0.5f);
+				replyData->data = int16_t(mParameters.edit().band[arg] * 100 + 0.5f);
 				*replySize = sizeof(reply2x4_1x2_t);
 				return 0;
 			}
@@ -212,9 +262,10 @@ int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 			int32_t cmd = ((int32_t *) cep)[3];
 			if (cmd == CUSTOM_EQ_PARAM_LOUDNESS_CORRECTION) {
 				int16_t value = ((int16_t *) cep)[8];
-				mLoudnessAdjustment = value / 100.0;
+				mParameters.edit().loudnessAdjustment = value / 100.0;
+				publishParameters(mParameters);
 #ifdef DEBUG
-				ALOGI("Setting loudness correction reference to %f dB", mLoudnessAdjustment);
+				ALOGI("Setting loudness correction reference to %f dB", value / 100.0);
 #endif
 				*replyData = 0;
 				return 0;
@@ -231,7 +282,8 @@ int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 #ifdef DEBUG
 				ALOGI("Setting band %d to %d", arg, value);
 #endif
-				mBand[arg] = (double)value / 100.0;
+				mParameters.edit().band[arg] = (double)value / 100.0;
+				publishParameters(mParameters);
 				return 0;
 			}
 		}
@@ -255,8 +307,9 @@ int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
 					return 0;
 				}
 				for (int i = 0; i < NUM_BANDS; i++) {
-					mBand[i] = ((int16_t *) cep)[10 + i] / 100.0;
+					mParameters.edit().band[i] = ((int16_t *) cep)[10 + i] / 100.0;
 				}
+				publishParameters(mParameters);
 
 				return 0;
 			}
@@ -293,13 +346,13 @@ int32_t EffectEqualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdD
  * made for 100 dB or higher. User must configure a reference level that maps the
  * digital sound level against the SPL achieved in the ear.
  */
-double EffectEqualizer::getAdjustedBand(int32_t band, double loudness) {
+double EffectEqualizer::getAdjustedBand(const EqualizerParameters& parameters, int32_t band, double loudness, int32_t fade) {
 	/* 1st derived by linear extrapolation from (62.5, 28) to (20, 41) */
 	const double adj_beg[NUM_BANDS] = {  0.0,  0.0,  0.0,  0.0, -1.0, -1.5 };
 	const double adj_end[NUM_BANDS] = { 42.3, 28.0, 10.0,  0.0, -3.0,  8.0 };
 
 	/* Add loudness adjustment */
-	double loudnessLevel = loudness + mLoudnessAdjustment;
+	double loudnessLevel = loudness + parameters.loudnessAdjustment;
 	if (loudnessLevel > 100.0) {
 		loudnessLevel = 100.0;
 	}
@@ -310,31 +363,91 @@ double EffectEqualizer::getAdjustedBand(int32_t band, double loudness) {
 	loudnessLevel = (loudnessLevel - 20.0) / (100.0 - 20.0);
 
 	/* Read user setting */
-	double f = mBand[band];
+	double f = parameters.band[band];
 	/* Add compensation values */
 	f += adj_beg[band] + (adj_end[band] - adj_beg[band]) * (1.0 - loudnessLevel);
 	/* Account for effect smooth fade in/out */
-	return f * (mFade / 100.0);
+	return f * (fade / 100.0);
 }
 
-void EffectEqualizer::refreshBands()
+/* The shelf cascade of one channel. Depends only on its arguments, so
+ * that it can run on either thread. */
+void EffectEqualizer::designChannel(const EqualizerParameters& parameters, double loudness, int32_t fade, double samplingRate, double (*coefficients)[5])
 {
 	for (int32_t band = 0; band < (NUM_BANDS - 1); band ++) {
 		/* 15.625, 62.5, 250, 1000, 4000, 16000 */
 		double centerFrequency = 15.625 * pow(4, band);
 
-		double dBL = getAdjustedBand(band + 1, mLoudnessL) - getAdjustedBand(band, mLoudnessL);
-		double overallGainL = band == 0 ? getAdjustedBand(0, mLoudnessL) : 0.0;
-		mFilterL[band].setHighShelf(mNextUpdateInterval, centerFrequency * 2.0, mSamplingRate, dBL, 1.0, overallGainL);
+		double dB = getAdjustedBand(parameters, band + 1, loudness, fade) - getAdjustedBand(parameters, band, loudness, fade);
+		double overallGain = band == 0 ? getAdjustedBand(parameters, 0, loudness, fade) : 0.0;
+
+		Biquad design;
+		design.setHighShelf(0, centerFrequency * 2.0, samplingRate, dB, 1.0, overallGain);
+		design.getCoefficients(coefficients[band]);
+	}
+}
+
+void EffectEqualizer::refreshBands()
+{
+#ifdef DSP_DESIGNER_THREAD
+	if (mDesigner) {
+		/* Take the last finished design, unless it predates a change
+		 * of sampling rate, and hand over the state for the next one. */
+		if (mDesign.consume() && mDesign.current().samplingRate == mSamplingRate) {
+			const EqualizerDesign& design = mDesign.current();
+			for (int32_t channel = 0; channel < design.channels && channel < mChannels; channel ++) {
+				for (int32_t band = 0; band < (NUM_BANDS - 1); band ++) {
+					mFilters.setFilter(channel, band, mNextUpdateInterval, design.coefficients[channel][band]);
+				}
+			}
+		}
+
+		EqualizerDesignInput& input = mDesignInput.edit();
+		input.parameters = mParameters.current();
+		for (int32_t channel = 0; channel < mChannels; channel ++) {
+			input.loudness[channel] = mLoudness[channel];
+		}
+		input.fade = mFade;
+		input.channels = mChannels;
+		input.samplingRate = mSamplingRate;
+		mDesignInput.publish();
+		Designer::request(this);
+		return;
+	}
+#endif
+
+	for (int32_t channel = 0; channel < mChannels; channel ++) {
+		double coefficients[NUM_BANDS - 1][5];
+		designChannel(mParameters.current(), mLoudness[channel], mFade, mSamplingRate, coefficients);
+		for (int32_t band = 0; band < (NUM_BANDS - 1); band ++) {
+			mFilters.setFilter(channel, band, mNextUpdateInterval, coefficients[band]);
+		}
+	}
+}
+
+#ifdef DSP_DESIGNER_THREAD
+/* Designer thread */
+void EffectEqualizer::design()
+{
+	if (!mDesignInput.consume()) {
+		return;
+	}
 
-		double dBR = getAdjustedBand(band + 1, mLoudnessR) - getAdjustedBand(band, mLoudnessR);
-		double overallGainR = band == 0 ? getAdjustedBand(0, mLoudnessR) : 0.0;
-		mFilterR[band].setHighShelf(mNextUpdateInterval, centerFrequency * 2.0, mSamplingRate, dBR, 1.0, overallGainR);
+	const EqualizerDesignInput& input = mDesignInput.current();
+	EqualizerDesign& design = mDesign.edit();
+	for (int32_t channel = 0; channel < input.channels; channel ++) {
+		designChannel(input.parameters, input.loudness[channel], input.fade, input.samplingRate, design.coefficients[channel]);
 	}
+	design.channels = input.channels;
+	design.samplingRate = input.samplingRate;
+	mDesign.publish();
 }
+#endif
 
-void EffectEqualizer::updateLoudnessEstimate(double& loudness, double powerSquared) {
-	double signalPowerDb = 96.0 + log10(powerSquared / double(mNextUpdateInterval) / 281474976710656.0 + 1e-10) * 10.0;
+/* power is relative to full scale. The SPL mapping was calibrated against
+ * 2^48, which sits 6 dB above s16 full scale power. */
+void EffectEqualizer::updateLoudnessEstimate(double& loudness, double power) {
+	double signalPowerDb = 96.0 - 6.0206 + log10(power + 1e-10) * 10.0;
 	/* Immediate rise-time, and perceptibly linear 10 dB/s decay */
 	if (loudness > signalPowerDb + 0.1) {
 		loudness -= 0.1;
@@ -343,62 +456,37 @@ void EffectEqualizer::updateLoudnessEstimate(double& loudness, double powerSquar
 	}
 }
 
-int32_t EffectEqualizer::process(audio_buffer_t *in, audio_buffer_t *out)
+void EffectEqualizer::processSamples(sample_t* const* planes, int32_t frames)
 {
-	double tmpL = 0.0, tmpR = 0.0;
-	for (uint32_t i = 0; i < in->frameCount; i ++) {
-
-		/* Read sound input.  */
-		if (formatFloatModeInt32Mode == 0) {
-			tmpL = read(in, i << 1);
-			tmpR = read(in, (i << 1) + 1);
-
-			/* Update signal loudness estimate in SPL */
-			mPowerSquaredL += pow(tmpL, 2);
-			mPowerSquaredR += pow(tmpR, 2);
-		}
-		else if (formatFloatModeInt32Mode == 1) {
-			tmpL = readPcmFloat(in, i << 1);
-			tmpR = readPcmFloat(in, (i << 1) + 1);
-
-			/* Update signal loudness estimate in SPL */
-			mPowerSquaredL += pow(tmpL, 2) * 50.0;
-			mPowerSquaredR += pow(tmpR, 2) * 50.0;
-		}
-		else if (formatFloatModeInt32Mode == 2) {
-			tmpL = (double)in->s32[i * 2];
-			tmpR = (double)in->s32[i * 2 + 1];
-
-			/* Update signal loudness estimate in SPL */
-			mPowerSquaredL += pow(tmpL, 2);
-			mPowerSquaredR += pow(tmpR, 2);
+	/* Runs up to and including the frame that triggers the next update,
+	 * so filter changes land on the same frames as before. */
+	int32_t j = 0;
+	while (j < frames) {
+		int32_t count = frames - j < mNextUpdate + 1 ? frames - j : mNextUpdate + 1;
+
+		/* Update signal loudness estimate in SPL, and evaluate EQ
+		 * filters */
+		sample_t* segment[EFFECT_MAX_CHANNELS];
+		for (int32_t c = 0; c < mChannels; c ++) {
+			segment[c] = planes[c] + j;
+			mDetector[c].accumulate(segment[c], count);
 		}
+		mFilters.process(segment, count);
 
-
-		/* Evaluate EQ filters */
-		for (int32_t j = 0; j < (NUM_BANDS - 1); j ++) {
-			tmpL = mFilterL[j].process(tmpL);
-			tmpR = mFilterR[j].process(tmpR);
-		}
+		j += count;
+		mNextUpdate -= count;
 
 		/* Update EQ? */
-		if (mNextUpdate == 0) {
-			mNextUpdate = mNextUpdateInterval;
+		if (mNextUpdate < 0) {
+			mNextUpdate = mNextUpdateInterval - 1;
 
+			for (int32_t c = 0; c < mChannels; c ++) {
+				updateLoudnessEstimate(mLoudness[c], mDetector[c].update());
+			}
 #ifdef DEBUG
-			ALOGI("powerSqL: %lld, powerSqR: %lld", mPowerSquaredL, mPowerSquaredR);
-#endif
-			updateLoudnessEstimate(mLoudnessL, mPowerSquaredL);
-			updateLoudnessEstimate(mLoudnessR, mPowerSquaredR);
-#ifdef DEBUG
-			ALOGI("loudnessL: %f, loudnessR: %f", mLoudnessL, mLoudnessR);
+			ALOGI("loudnessL: %f, loudnessR: %f", mLoudness[0], mLoudness[1]);
 #endif
 
-			/* clean up loudness cache */
-			mPowerSquaredL = 0;
-			mPowerSquaredR = 0;
-
-
 			if (mEnable && mFade < 100) {
 				mFade += 1;
 			}
@@ -408,22 +496,62 @@ int32_t EffectEqualizer::process(audio_buffer_t *in, audio_buffer_t *out)
 
 			refreshBands();
 		}
+	}
+}
 
-		if (formatFloatModeInt32Mode == 0) {
-			write(out, i << 1, tmpL);
-			write(out, (i << 1) + 1, tmpR);
-		}
-		else if (formatFloatModeInt32Mode == 1) {
-			writePcmFloat(out, i << 1, tmpL);
-			writePcmFloat(out, (i << 1) + 1, tmpR);
+int32_t EffectEqualizer::processPlanes(double* const* planes, int32_t frames)
+{
+	/* New settings reach the filters at the next update. */
+	mParameters.consume();
+
+#ifdef DSP_FIXED_POINT
+	sample_t* samples[EFFECT_MAX_CHANNELS];
+	for (int32_t c = 0; c < mChannels; c ++) {
+		samples[c] = mPlanes[c];
+	}
+
+	for (int32_t start = 0; start < frames; start += EQUALIZER_BLOCK) {
+		int32_t n = frames - start < EQUALIZER_BLOCK ? frames - start : EQUALIZER_BLOCK;
+		for (int32_t c = 0; c < mChannels; c ++) {
+			samplesFromDouble(planes[c] + start, samples[c], n);
 		}
-		else if (formatFloatModeInt32Mode == 2) {
-			out->s32[i << 1] = (int32_t)tmpL;
-			out->s32[(i << 1) + 1] = (int32_t)tmpR;
+		processSamples(samples, n);
+		for (int32_t c = 0; c < mChannels; c ++) {
+			samplesToDouble(samples[c], planes[c] + start, n);
 		}
+	}
+#else
+	processSamples(planes, frames);
+#endif
 
-		mNextUpdate --;
+	return mEnable || mFade != 0 ? 0 : -ENODATA;
+}
+
+#ifdef DSP_FIXED_POINT
+/* Standalone, the integer engine reads the PCM buffer directly. */
+int32_t EffectEqualizer::process(audio_buffer_t *in, audio_buffer_t *out)
+{
+	mParameters.consume();
+
+	sample_t* planes[EFFECT_MAX_CHANNELS];
+	for (int32_t c = 0; c < mChannels; c ++) {
+		planes[c] = mPlanes[c];
+	}
+
+	for (uint32_t start = 0; start < in->frameCount; start += EQUALIZER_BLOCK) {
+		int32_t n = in->frameCount - start < EQUALIZER_BLOCK ? in->frameCount - start : EQUALIZER_BLOCK;
+
+		readPlanes(in, start, planes, n);
+		processSamples(planes, n);
+		writePlanes(out, start, planes, n);
 	}
 
 	return mEnable || mFade != 0 ? 0 : -ENODATA;
 }
+#endif
+
+/* Loudness estimate of the left channel */
+float EffectEqualizer::getTraceState()
+{
+	return float(mLoudness[0]);
+}
@@ -3,35 +3,92 @@
 #include "system/audio_effects/effect_equalizer.h"
 
 #include "Biquad.h"
+#include "BiquadBank.h"
+#include "Designer.h"
 #include "Effect.h"
+#include "LevelDetector.h"
+#include "ParameterBuffer.h"
 
 #define CUSTOM_EQ_PARAM_LOUDNESS_CORRECTION 1000
 
-class EffectEqualizer : public Effect {
-	private:
-	double mBand[6];
-	Biquad mFilterL[5], mFilterR[5];
+/* Frames per integer engine pass, DSP_FIXED_POINT only. */
+#define EQUALIZER_BLOCK 256
 
+/* User settings, dB */
+struct EqualizerParameters {
+	double band[6];
 	/* Automatic equalizer */
-	double mLoudnessAdjustment;
+	double loudnessAdjustment;
+};
+
+#ifdef DSP_DESIGNER_THREAD
+/* Everything a redesign depends on, from the audio thread */
+struct EqualizerDesignInput {
+	EqualizerParameters parameters;
+	double loudness[EFFECT_MAX_CHANNELS];
+	int32_t fade;
+	int32_t channels;
+	double samplingRate;
+};
+
+/* Coefficients of the five shelves per channel, see
+ * Biquad::getCoefficients() */
+struct EqualizerDesign {
+	double coefficients[EFFECT_MAX_CHANNELS][5][5];
+	int32_t channels;
+	double samplingRate;
+};
+#endif
+
+class EffectEqualizer : public Effect
+#ifdef DSP_DESIGNER_THREAD
+		, public DesignerJob
+#endif
+{
+	private:
+	ParameterBuffer<EqualizerParameters> mParameters;
+	BiquadBank mFilters;
 
-	double mLoudnessL;
-	double mLoudnessR;
+#ifdef DSP_DESIGNER_THREAD
+	/* The loudness tracking redesign runs on the designer thread and
+	 * lands one update interval later. */
+	bool mDesigner;
+	ParameterBuffer<EqualizerDesignInput> mDesignInput;
+	ParameterBuffer<EqualizerDesign> mDesign;
+#endif
+
+	double mLoudness[EFFECT_MAX_CHANNELS];
 	int32_t mNextUpdate;
 	int32_t mNextUpdateInterval;
-	double mPowerSquaredL;
-	double mPowerSquaredR;
+	LevelDetector mDetector[EFFECT_MAX_CHANNELS];
 
 	/* Smooth enable/disable */
 	int32_t mFade;
 
+#ifdef DSP_FIXED_POINT
+	sample_t mPlanes[EFFECT_MAX_CHANNELS][EQUALIZER_BLOCK];
+#endif
+
+	void setDefaults();
 	void setBand(int32_t idx, float dB);
-	double getAdjustedBand(int32_t idx, double loudness);
+	static double getAdjustedBand(const EqualizerParameters& parameters, int32_t idx, double loudness, int32_t fade);
+	static void designChannel(const EqualizerParameters& parameters, double loudness, int32_t fade, double samplingRate, double (*coefficients)[5]);
 	void refreshBands();
-	void updateLoudnessEstimate(double& loudness, double powerSquared);
+	void updateLoudnessEstimate(double& loudness, double power);
+	void processSamples(sample_t* const* planes, int32_t frames);
+	void commitParameters();
 
 	public:
 	EffectEqualizer();
+	void recycle();
+#ifdef DSP_DESIGNER_THREAD
+	~EffectEqualizer();
+	void design();
+#endif
 	int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData);
+	int32_t processPlanes(double* const* planes, int32_t frames);
+	float getTraceState();
+#ifdef DSP_FIXED_POINT
 	int32_t process(audio_buffer_t *in, audio_buffer_t *out);
+#endif
 };
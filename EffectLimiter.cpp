@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef DEBUG
+#define LOG_TAG "Effect-Limiter"
+
+#include <log/log.h>
+#endif
+
+#include <cmath>
+#include <string.h>
+
+#include "EffectLimiter.h"
+#include "Simd.h"
+
+typedef struct {
+	int32_t status;
+	uint32_t psize;
+	uint32_t vsize;
+	int32_t cmd;
+	int16_t data;
+} reply1x4_1x2_t;
+
+EffectLimiter::EffectLimiter()
+	: mLookahead(15), mEnvelope(1.0),
+		mBox(0), mBoxCapacity(0), mBoxIndex(0), mBoxSum(0.0)
+{
+	/* 4x oversampling interpolator, Hann windowed sinc. Phase p estimates
+	 * the signal (p + 1) / 4 of a sample after the center tap. */
+	for (int32_t p = 0; p < 3; p ++) {
+		double frac = (p + 1) / 4.0;
+		for (int32_t k = 0; k < TRUE_PEAK_TAPS; k ++) {
+			double d = k - TRUE_PEAK_TAPS / 2 + frac;
+			double window = 0.5 + 0.5 * cos(M_PI * d / (TRUE_PEAK_TAPS / 2));
+			mPhase[p][k] = sin(M_PI * d) / (M_PI * d) * window;
+		}
+	}
+
+	setDefaults();
+}
+
+EffectLimiter::~EffectLimiter()
+{
+	delete[] mBox;
+}
+
+void EffectLimiter::recycle()
+{
+	Effect::recycle();
+	setDefaults();
+}
+
+/* refreshLookahead() clears the detector, envelope and history too. */
+void EffectLimiter::setDefaults()
+{
+	LimiterParameters parameters;
+	parameters.ceiling = -100;
+	parameters.lookahead = 15;
+	parameters.release = 60;
+	mParameters.reset(parameters);
+
+	reserveLookahead();
+	refreshCeiling();
+	refreshLookahead();
+	refreshRelease();
+}
+
+void EffectLimiter::commitParameters()
+{
+	mParameters.publish();
+}
+
+int32_t EffectLimiter::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData)
+{
+	if (cmdCode == EFFECT_CMD_SET_CONFIG) {
+		int32_t ret = Effect::configure(pCmdData);
+		if (ret != 0) {
+			int32_t *replyData = (int32_t *) pReplyData;
+			*replyData = ret;
+			return 0;
+		}
+
+		reserveLookahead();
+		refreshCeiling();
+		refreshLookahead();
+		refreshRelease();
+
+		int32_t *replyData = (int32_t *) pReplyData;
+		*replyData = 0;
+		return 0;
+	}
+
+	if (cmdCode == EFFECT_CMD_GET_PARAM) {
+		effect_param_t *cep = (effect_param_t *) pCmdData;
+		if (cep->psize == 4) {
+			int32_t cmd = ((int32_t *) cep)[3];
+			if (cmd == LIMITER_PARAM_CEILING || cmd == LIMITER_PARAM_LOOKAHEAD || cmd == LIMITER_PARAM_RELEASE) {
+				reply1x4_1x2_t *replyData = (reply1x4_1x2_t *) pReplyData;
+				replyData->status = 0;
+				replyData->vsize = 2;
+				const LimiterParameters& parameters = mParameters.edit();
+				replyData->data = cmd == LIMITER_PARAM_CEILING ? parameters.ceiling
+						: cmd == LIMITER_PARAM_LOOKAHEAD ? parameters.lookahead : parameters.release;
+				*replySize = sizeof(reply1x4_1x2_t);
+				return 0;
+			}
+		}
+
+#ifdef DEBUG
+		ALOGE("Unknown GET_PARAM of %d bytes", cep->psize);
+#endif
+
+		effect_param_t *replyData = (effect_param_t *) pReplyData;
+		replyData->status = -EINVAL;
+		replyData->vsize = 0;
+		*replySize = sizeof(effect_param_t);
+		return 0;
+	}
+
+	if (cmdCode == EFFECT_CMD_SET_PARAM) {
+		effect_param_t *cep = (effect_param_t *) pCmdData;
+		int32_t *replyData = (int32_t *) pReplyData;
+		if (cep->psize == 4 && cep->vsize == 2) {
+			int32_t cmd = ((int32_t *) cep)[3];
+			int16_t value = ((int16_t *) cep)[8];
+			/* -20.00 .. 0.00 dBFS */
+			if (cmd == LIMITER_PARAM_CEILING && value >= -2000 && value <= 0) {
+				mParameters.edit().ceiling = value;
+				publishParameters(mParameters);
+				*replyData = 0;
+				return 0;
+			}
+			/* 0.1 .. 10.0 ms */
+			if (cmd == LIMITER_PARAM_LOOKAHEAD && value >= 1 && value <= 100) {
+				mParameters.edit().lookahead = value;
+				publishParameters(mParameters);
+				*replyData = 0;
+				return 0;
+			}
+			/* 1 .. 1000 ms */
+			if (cmd == LIMITER_PARAM_RELEASE && value >= 1 && value <= 1000) {
+				mParameters.edit().release = value;
+				publishParameters(mParameters);
+				*replyData = 0;
+				return 0;
+			}
+		}
+
+#ifdef DEBUG
+		ALOGE("Unknown SET_PARAM of %d, %d bytes", cep->psize, cep->vsize);
+#endif
+
+		*replyData = -EINVAL;
+		return 0;
+	}
+
+	return Effect::command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+}
+
+/* Sizes the lookahead buffers for the longest window allowed, so that
+ * refreshLookahead() never allocates when process() calls it. */
+void EffectLimiter::reserveLookahead()
+{
+	int32_t window = int32_t(100 * mSamplingRate / 10000.0 + 0.5);
+	if (window < 1) {
+		window = 1;
+	}
+	int32_t delay = window - 1 + TRUE_PEAK_TAPS / 2;
+
+	mPeak.setWindow(window);
+	for (int32_t c = 0; c < EFFECT_MAX_CHANNELS; c ++) {
+		mDelay[c].setParameters(mSamplingRate, delay / mSamplingRate);
+	}
+	if (window > mBoxCapacity) {
+		delete[] mBox;
+		mBox = new double[window];
+		mBoxCapacity = window;
+	}
+}
+
+void EffectLimiter::refreshCeiling()
+{
+	mCeilingLevel = PCM_FULL_SCALE * pow(10.0, mParameters.current().ceiling / 2000.0);
+}
+
+/* The peak detector looks mWindow frames ahead of the audio, and the
+ * gain is box filtered over the same window so that every reduction
+ * ramps in fully before the peak that caused it is output. The
+ * interpolator reports peaks TRUE_PEAK_TAPS / 2 frames late, which the
+ * audio delay also covers. */
+void EffectLimiter::refreshLookahead()
+{
+	mLookahead = mParameters.current().lookahead;
+	mWindow = int32_t(mLookahead * mSamplingRate / 10000.0 + 0.5);
+	if (mWindow < 1) {
+		mWindow = 1;
+	}
+	int32_t delay = mWindow - 1 + TRUE_PEAK_TAPS / 2;
+
+	mPeak.setWindow(mWindow);
+	for (int32_t c = 0; c < EFFECT_MAX_CHANNELS; c ++) {
+		mDelay[c].setParameters(mSamplingRate, delay / mSamplingRate);
+	}
+
+	for (int32_t i = 0; i < mWindow; i ++) {
+		mBox[i] = 1.0;
+	}
+	mBoxIndex = 0;
+	mBoxSum = mWindow;
+	mEnvelope = 1.0;
+
+	memset(mHistory, 0, sizeof(mHistory));
+}
+
+void EffectLimiter::refreshRelease()
+{
+	mReleaseCoeff = 1.0 - exp(-1000.0 / (mParameters.current().release * mSamplingRate));
+}
+
+/* x[-k] holds the input k frames before x[0]. Returns the largest of
+ * the center tap and the three interpolated points that follow it. */
+double EffectLimiter::truePeak(const double* x)
+{
+	double peak = fabs(x[-TRUE_PEAK_TAPS / 2]);
+	for (int32_t p = 0; p < 3; p ++) {
+		double value = 0.0;
+		for (int32_t k = 0; k < TRUE_PEAK_TAPS; k ++) {
+			value += mPhase[p][k] * x[-k];
+		}
+		value = fabs(value);
+		if (value > peak) {
+			peak = value;
+		}
+	}
+	return peak;
+}
+
+static inline v2df absolute(v2df x)
+{
+	return x > -x ? x : -x;
+}
+
+/* Raises linked[j] to the true peak of frame j of x, preceded by
+ * TRUE_PEAK_TAPS - 1 frames of history. Two frames at a time, one per
+ * lane; each lane sums in truePeak()'s order, so the peaks are the
+ * same to the bit. */
+void EffectLimiter::truePeaks(const double* x, double* linked, int32_t frames)
+{
+	v2df phase[3][TRUE_PEAK_TAPS];
+	for (int32_t p = 0; p < 3; p ++) {
+		for (int32_t k = 0; k < TRUE_PEAK_TAPS; k ++) {
+			phase[p][k] = (v2df) { mPhase[p][k], mPhase[p][k] };
+		}
+	}
+
+	int32_t j = 0;
+	for (; j + 2 <= frames; j += 2) {
+		const double* y = x + j;
+		v2df peak;
+		memcpy(&peak, y - TRUE_PEAK_TAPS / 2, sizeof(peak));
+		peak = absolute(peak);
+		for (int32_t p = 0; p < 3; p ++) {
+			v2df value = { 0.0, 0.0 };
+			for (int32_t k = 0; k < TRUE_PEAK_TAPS; k ++) {
+				v2df in;
+				memcpy(&in, y - k, sizeof(in));
+				value += phase[p][k] * in;
+			}
+			value = absolute(value);
+			peak = value > peak ? value : peak;
+		}
+
+		v2df l;
+		memcpy(&l, linked + j, sizeof(l));
+		l = peak > l ? peak : l;
+		memcpy(linked + j, &l, sizeof(l));
+	}
+	for (; j < frames; j ++) {
+		double peak = truePeak(x + j);
+		if (peak > linked[j]) {
+			linked[j] = peak;
+		}
+	}
+}
+
+/* Turns peaks into the gain that brings each down to the ceiling, in
+ * place. Frames are independent, so this runs two at a time. */
+static void targetGains(double* x, int32_t frames, double ceiling)
+{
+	v2df c = { ceiling, ceiling };
+	v2df one = { 1.0, 1.0 };
+	int32_t j = 0;
+	for (; j + 2 <= frames; j += 2) {
+		v2df peak;
+		memcpy(&peak, x + j, sizeof(peak));
+		v2df target = peak > c ? c / peak : one;
+		memcpy(x + j, &target, sizeof(target));
+	}
+	for (; j < frames; j ++) {
+		x[j] = x[j] > ceiling ? ceiling / x[j] : 1.0;
+	}
+}
+
+/* x -= box over frames, while the box takes x's place. */
+static void swapDifferences(double* x, double* box, int32_t frames)
+{
+	int32_t j = 0;
+	for (; j + 2 <= frames; j += 2) {
+		v2df a, b;
+		memcpy(&a, x + j, sizeof(a));
+		memcpy(&b, box + j, sizeof(b));
+		memcpy(box + j, &a, sizeof(a));
+		a -= b;
+		memcpy(x + j, &a, sizeof(a));
+	}
+	for (; j < frames; j ++) {
+		double a = x[j];
+		x[j] = a - box[j];
+		box[j] = a;
+	}
+}
+
+static void scale(double* x, int32_t frames, double divisor)
+{
+	v2df d = { divisor, divisor };
+	int32_t j = 0;
+	for (; j + 2 <= frames; j += 2) {
+		v2df a;
+		memcpy(&a, x + j, sizeof(a));
+		a /= d;
+		memcpy(x + j, &a, sizeof(a));
+	}
+	for (; j < frames; j ++) {
+		x[j] /= divisor;
+	}
+}
+
+/* The gain computer, over gain[] holding the linked peaks: the target
+ * gain, instant attack with exponential release, then the box filter.
+ *
+ * Everything but two recursions runs in vector passes. The envelope
+ * takes a branch on its own previous value at every frame, and the box
+ * filter is a running sum; written as parallel scans both would need
+ * several times the operations, and would round differently from the
+ * one add per frame they cost here. They stay scalar, each a single
+ * tight loop. The result is bit for bit that of the per-frame form. */
+void EffectLimiter::gainComputer(double* gain, int32_t frames)
+{
+	targetGains(gain, frames, mCeilingLevel);
+
+	double envelope = mEnvelope;
+	for (int32_t j = 0; j < frames; j ++) {
+		double target = gain[j];
+		if (target < envelope) {
+			envelope = target;
+		} else {
+			envelope += (target - envelope) * mReleaseCoeff;
+		}
+		gain[j] = envelope;
+	}
+	mEnvelope = envelope;
+
+	/* In runs up to the end of the box, so that each run reads the
+	 * values earlier runs left. */
+	double sum = mBoxSum;
+	for (int32_t j = 0; j < frames; ) {
+		int32_t n = mWindow - mBoxIndex;
+		if (n > frames - j) {
+			n = frames - j;
+		}
+		swapDifferences(gain + j, mBox + mBoxIndex, n);
+		for (int32_t i = j; i < j + n; i ++) {
+			sum += gain[i];
+			gain[i] = sum;
+		}
+		mBoxIndex = mBoxIndex + n == mWindow ? 0 : mBoxIndex + n;
+		j += n;
+	}
+	mBoxSum = sum;
+
+	scale(gain, frames, mWindow);
+}
+
+int32_t EffectLimiter::processPlanes(double* const* planes, int32_t frames)
+{
+	double gain[LIMITER_BLOCK], delayed[LIMITER_BLOCK];
+	double history[TRUE_PEAK_TAPS - 1 + LIMITER_BLOCK];
+
+	if (mParameters.consume()) {
+		refreshCeiling();
+		refreshRelease();
+		if (mParameters.current().lookahead != mLookahead) {
+			refreshLookahead();
+		}
+	}
+
+	/* Delay::read() and write() work on at most one delay length. */
+	int32_t blockLimit = LIMITER_BLOCK;
+	if (mDelay[0].getLength() < blockLimit) {
+		blockLimit = mDelay[0].getLength();
+	}
+
+	for (int32_t start = 0; start < frames; start += blockLimit) {
+		int32_t n = frames - start < blockLimit ? frames - start : blockLimit;
+
+		/* Peak linked across all channels */
+		for (int32_t j = 0; j < n; j ++) {
+			gain[j] = 0.0;
+		}
+		for (int32_t c = 0; c < mChannels; c ++) {
+			memcpy(history, mHistory[c], sizeof(mHistory[c]));
+			memcpy(history + TRUE_PEAK_TAPS - 1, planes[c] + start, n * sizeof(double));
+			truePeaks(history + TRUE_PEAK_TAPS - 1, gain, n);
+			memcpy(mHistory[c], history + n, sizeof(mHistory[c]));
+		}
+		for (int32_t j = 0; j < n; j ++) {
+			gain[j] = mPeak.process(gain[j]);
+		}
+		gainComputer(gain, n);
+
+		/* Apply to the delayed signal. */
+		for (int32_t c = 0; c < mChannels; c ++) {
+			double* x = planes[c] + start;
+			mDelay[c].read(delayed, n);
+			mDelay[c].write(x, n);
+			for (int32_t j = 0; j < n; j ++) {
+				x[j] = delayed[j] * gain[j];
+			}
+		}
+	}
+
+	return mEnable ? 0 : -ENODATA;
+}
+
+/* Gain reduction */
+float EffectLimiter::getTraceState()
+{
+	return float(20.0 * log10(fmax(mEnvelope, 1e-5)));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Delay.h"
+#include "Effect.h"
+#include "ParameterBuffer.h"
+#include "SlidingMax.h"
+
+#define LIMITER_PARAM_CEILING 0
+#define LIMITER_PARAM_LOOKAHEAD 1
+#define LIMITER_PARAM_RELEASE 2
+
+/* Frames per block pass in processPlanes(). */
+#define LIMITER_BLOCK 256
+
+/* Taps per phase of the 4x true-peak interpolator. */
+#define TRUE_PEAK_TAPS 12
+
+/* User parameters: 0.01 dBFS, 0.1 ms and ms. Set by command(), applied
+ * by process() at the next buffer. */
+struct LimiterParameters {
+	int16_t ceiling;
+	int16_t lookahead;
+	int16_t release;
+};
+
+class EffectLimiter : public Effect {
+	private:
+	ParameterBuffer<LimiterParameters> mParameters;
+	/* Lookahead the delay lines are currently set for */
+	int16_t mLookahead;
+
+	double mCeilingLevel;
+	double mReleaseCoeff;
+	int32_t mWindow;
+
+	SlidingMax mPeak;
+	Delay mDelay[EFFECT_MAX_CHANNELS];
+	double mEnvelope;
+	double* mBox;
+	int32_t mBoxCapacity;
+	int32_t mBoxIndex;
+	double mBoxSum;
+
+	double mPhase[3][TRUE_PEAK_TAPS];
+	/* The last inputs of each channel, oldest first */
+	double mHistory[EFFECT_MAX_CHANNELS][TRUE_PEAK_TAPS - 1];
+
+	void setDefaults();
+	void reserveLookahead();
+	void refreshCeiling();
+	void refreshLookahead();
+	void refreshRelease();
+	double truePeak(const double* x);
+	void truePeaks(const double* x, double* linked, int32_t frames);
+	void gainComputer(double* gain, int32_t frames);
+	void commitParameters();
+
+	public:
+	EffectLimiter();
+	~EffectLimiter();
+	void recycle();
+
+	int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData);
+	int32_t processPlanes(double* const* planes, int32_t frames);
+	float getTraceState();
+};
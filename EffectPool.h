@@ -0,0 +1,83 @@
+#pragma once
+
+#include <new>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Released instances kept per type */
+#define EFFECT_POOL_SIZE 4
+
+/* Instances start on a cache line. */
+#define EFFECT_POOL_ALIGNMENT 64
+
+/* Keeps released instances of T, each with all its buffers, so that a
+ * new session takes one over instead of allocating. T must have a
+ * recycle() that returns it to the state of a new instance.
+ *
+ * The pool starts empty and fills as sessions are released, up to
+ * EFFECT_POOL_SIZE; releases beyond that free the instance. */
+template <typename T>
+class EffectPool {
+	pthread_mutex_t mLock;
+	T* mFree[EFFECT_POOL_SIZE];
+	int32_t mCount;
+
+	static void destroy(T* instance)
+	{
+		instance->~T();
+		free(instance);
+	}
+
+	public:
+	EffectPool()
+		: mCount(0)
+	{
+		pthread_mutex_init(&mLock, NULL);
+	}
+
+	~EffectPool()
+	{
+		while (mCount > 0) {
+			destroy(mFree[-- mCount]);
+		}
+		pthread_mutex_destroy(&mLock);
+	}
+
+	/* Returns NULL if a new instance could not be allocated. */
+	T* acquire()
+	{
+		T* instance = NULL;
+		pthread_mutex_lock(&mLock);
+		if (mCount > 0) {
+			instance = mFree[-- mCount];
+		}
+		pthread_mutex_unlock(&mLock);
+		if (instance != NULL) {
+			return instance;
+		}
+
+		void* memory = NULL;
+		if (posix_memalign(&memory, EFFECT_POOL_ALIGNMENT, sizeof(T)) != 0) {
+			return NULL;
+		}
+		return new (memory) T();
+	}
+
+	void release(T* instance)
+	{
+		/* Outside the lock, resetting a large instance takes a while. */
+		instance->recycle();
+
+		pthread_mutex_lock(&mLock);
+		bool kept = mCount < EFFECT_POOL_SIZE;
+		if (kept) {
+			mFree[mCount ++] = instance;
+		}
+		pthread_mutex_unlock(&mLock);
+
+		if (!kept) {
+			destroy(instance);
+		}
+	}
+};
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "EffectStats.h"
+
+static inline void add(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static inline uint64_t get(const std::atomic<uint64_t>& counter)
+{
+	return counter.load(std::memory_order_relaxed);
+}
+
+EffectStats::EffectStats()
+{
+	reset();
+}
+
+/* Not while process() runs, e.g. when the instance is recycled. */
+void EffectStats::reset()
+{
+	mCalls.store(0, std::memory_order_relaxed);
+	mFrames.store(0, std::memory_order_relaxed);
+	mBypassed.store(0, std::memory_order_relaxed);
+	mTotalNs.store(0, std::memory_order_relaxed);
+	mMaxNs.store(0, std::memory_order_relaxed);
+	mClipped.store(0, std::memory_order_relaxed);
+	mDenormals.store(0, std::memory_order_relaxed);
+	for (int32_t i = 0; i < EFFECT_STATS_BUCKETS; i ++) {
+		mHistogram[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void EffectStats::recordCall(int32_t frames, int64_t ns, bool bypassed)
+{
+	add(mCalls, 1);
+	add(mFrames, frames);
+	if (bypassed) {
+		add(mBypassed, 1);
+	}
+	add(mTotalNs, ns);
+	if (uint64_t(ns) > get(mMaxNs)) {
+		mMaxNs.store(ns, std::memory_order_relaxed);
+	}
+
+	uint32_t us = uint32_t(ns / 1000);
+	int32_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+	if (bucket >= EFFECT_STATS_BUCKETS) {
+		bucket = EFFECT_STATS_BUCKETS - 1;
+	}
+	add(mHistogram[bucket], 1);
+}
+
+void EffectStats::recordSamples(uint64_t clipped, uint64_t denormals)
+{
+	if (clipped != 0) {
+		add(mClipped, clipped);
+	}
+	if (denormals != 0) {
+		add(mDenormals, denormals);
+	}
+}
+
+void EffectStats::dump(int fd, double samplingRate) const
+{
+	uint64_t calls = get(mCalls);
+	uint64_t frames = get(mFrames);
+	uint64_t totalNs = get(mTotalNs);
+
+	dprintf(fd, "    process() calls: %" PRIu64 ", bypassed: %" PRIu64 ", frames: %" PRIu64 "\n",
+			calls, get(mBypassed), frames);
+	if (calls == 0) {
+		return;
+	}
+
+	/* Share of one core spent per second of audio processed */
+	double audioNs = frames * 1e9 / samplingRate;
+	dprintf(fd, "    time per call: mean %.1f us, max %.1f us, load %.2f%%\n",
+			totalNs / 1e3 / calls, get(mMaxNs) / 1e3, audioNs > 0 ? 100.0 * totalNs / audioNs : 0.0);
+	dprintf(fd, "    samples over full scale: %" PRIu64 ", denormal: %" PRIu64 "\n",
+			get(mClipped), get(mDenormals));
+
+	dprintf(fd, "    time per call histogram:");
+	for (int32_t i = 0; i < EFFECT_STATS_BUCKETS; i ++) {
+		uint64_t count = get(mHistogram[i]);
+		if (count == 0) {
+			continue;
+		}
+		if (i == 0) {
+			dprintf(fd, " <1us: %" PRIu64, count);
+		} else if (i == EFFECT_STATS_BUCKETS - 1) {
+			dprintf(fd, " >=%dus: %" PRIu64, 1 << (i - 1), count);
+		} else {
+			dprintf(fd, " %d-%dus: %" PRIu64, 1 << (i - 1), 1 << i, count);
+		}
+	}
+	dprintf(fd, "\n");
+}
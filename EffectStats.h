@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+/* Buckets of the time per call histogram: under 1 us, then one per
+ * doubling from [1, 2) us up, the last one open ended (16 ms and up). */
+#define EFFECT_STATS_BUCKETS 16
+
+/* Counters kept by process() and printed on EFFECT_CMD_DUMP.
+ *
+ * Only the audio thread writes, so the counters are plain relaxed
+ * loads and stores, no read-modify-write. A dump running alongside
+ * process() may see one buffer counted in some fields and not yet in
+ * others. */
+class EffectStats {
+	std::atomic<uint64_t> mCalls;
+	std::atomic<uint64_t> mFrames;
+	std::atomic<uint64_t> mBypassed;
+	std::atomic<uint64_t> mTotalNs;
+	std::atomic<uint64_t> mMaxNs;
+	std::atomic<uint64_t> mClipped;
+	std::atomic<uint64_t> mDenormals;
+	std::atomic<uint64_t> mHistogram[EFFECT_STATS_BUCKETS];
+
+	public:
+	EffectStats();
+	void reset();
+
+	/* Audio thread: one process() call. */
+	void recordCall(int32_t frames, int64_t ns, bool bypassed);
+	/* Audio thread: output samples at or over full scale, and nonzero
+	 * output samples that would be denormal as float. */
+	void recordSamples(uint64_t clipped, uint64_t denormals);
+
+	void dump(int fd, double samplingRate) const;
+};
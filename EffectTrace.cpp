@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "EffectTrace.h"
+
+#define EFFECT_TRACE_MASK (EFFECT_TRACE_SIZE - 1)
+
+/* Records moved per pass of dumpJson() */
+#define EFFECT_TRACE_CHUNK 32
+
+static std::atomic<int32_t> sNextId(1);
+
+EffectTrace::EffectTrace()
+	: mId(sNextId.fetch_add(1, std::memory_order_relaxed))
+{
+	reset();
+}
+
+/* Not while process() runs, e.g. when the instance is recycled. */
+void EffectTrace::reset()
+{
+	mWrite.store(0, std::memory_order_relaxed);
+	mDropped.store(0, std::memory_order_relaxed);
+	mRead.store(0, std::memory_order_relaxed);
+	mDroppedRead = 0;
+	mGenerationRead = 0;
+	mGeneration.store(0, std::memory_order_relaxed);
+}
+
+void EffectTrace::changed()
+{
+	mGeneration.store(mGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+uint32_t EffectTrace::generation() const
+{
+	return mGeneration.load(std::memory_order_relaxed);
+}
+
+void EffectTrace::record(int64_t timestamp, int64_t duration, int32_t frames, uint32_t generation, float state)
+{
+	uint32_t write = mWrite.load(std::memory_order_relaxed);
+	if (write - mRead.load(std::memory_order_acquire) >= EFFECT_TRACE_SIZE) {
+		mDropped.store(mDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+
+	effect_trace_record_s& record = mRecords[write & EFFECT_TRACE_MASK];
+	record.timestamp = timestamp;
+	record.duration = duration > UINT32_MAX ? UINT32_MAX : uint32_t(duration);
+	record.frames = frames;
+	record.generation = generation;
+	record.state = state;
+	mWrite.store(write + 1, std::memory_order_release);
+}
+
+uint32_t EffectTrace::read(effect_trace_record_s* records, uint32_t capacity, uint32_t* dropped)
+{
+	uint32_t read = mRead.load(std::memory_order_relaxed);
+	uint32_t count = mWrite.load(std::memory_order_acquire) - read;
+	if (count > capacity) {
+		count = capacity;
+	}
+	for (uint32_t i = 0; i < count; i ++) {
+		records[i] = mRecords[(read + i) & EFFECT_TRACE_MASK];
+	}
+	mRead.store(read + count, std::memory_order_release);
+
+	uint32_t total = mDropped.load(std::memory_order_relaxed);
+	*dropped = total - mDroppedRead;
+	mDroppedRead = total;
+	return count;
+}
+
+void EffectTrace::dumpJson(int fd, const char* name)
+{
+	if (lseek(fd, 0, SEEK_CUR) == 0) {
+		dprintf(fd, "[\n");
+	}
+
+	int32_t pid = getpid();
+	dprintf(fd, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s #%d\"}},\n",
+			pid, mId, name, mId);
+
+	effect_trace_record_s records[EFFECT_TRACE_CHUNK];
+	uint32_t dropped;
+	uint32_t count;
+	while ((count = read(records, EFFECT_TRACE_CHUNK, &dropped)) != 0) {
+		/* Losses are only known to lie before the oldest record read. */
+		if (dropped != 0) {
+			dprintf(fd, "{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"records\":%u}},\n",
+					pid, mId, records[0].timestamp / 1e3, dropped);
+		}
+
+		for (uint32_t i = 0; i < count; i ++) {
+			const effect_trace_record_s& record = records[i];
+			double ts = record.timestamp / 1e3;
+			if (record.generation != mGenerationRead) {
+				dprintf(fd, "{\"name\":\"parameters\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"generation\":%u}},\n",
+						pid, mId, ts, record.generation);
+				mGenerationRead = record.generation;
+			}
+			dprintf(fd, "{\"name\":\"process\",\"cat\":\"dsp\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+					"\"args\":{\"frames\":%u,\"generation\":%u,\"state\":%.2f}},\n",
+					pid, mId, ts, record.duration / 1e3, record.frames, record.generation, record.state);
+			dprintf(fd, "{\"name\":\"%s #%d\",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3f,\"args\":{\"state\":%.2f}},\n",
+					name, mId, pid, ts, record.state);
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include "hardware/audio_effect.h"
+
+/* Proprietary commands, answered by every effect of the library.
+ *
+ * EFFECT_CMD_GET_TRACE takes no data. The reply is an
+ * effect_trace_header_s followed by as many of the oldest unread
+ * records as fit in *replySize; *replySize is set to the bytes written.
+ *
+ * EFFECT_CMD_DUMP_TRACE takes the uint32 file descriptor to print to,
+ * like EFFECT_CMD_DUMP, and has no reply. It writes the unread records
+ * as Chrome trace events, see EffectTrace::dumpJson(). */
+#define EFFECT_CMD_GET_TRACE (EFFECT_CMD_FIRST_PROPRIETARY + 0)
+#define EFFECT_CMD_DUMP_TRACE (EFFECT_CMD_FIRST_PROPRIETARY + 1)
+
+/* Records kept per effect, a power of two. About 1.4 s of 256 frame
+ * buffers at 48 kHz. */
+#define EFFECT_TRACE_SIZE 256
+
+/* One process() call. */
+struct effect_trace_record_s {
+	/* systemTime() at the start of the call, ns */
+	int64_t timestamp;
+	/* Time spent in the call, ns */
+	uint32_t duration;
+	uint32_t frames;
+	/* Count of parameter changes applied before the call, see
+	 * EffectTrace::changed() */
+	uint32_t generation;
+	/* Gain or loudness the effect was at, dB, see
+	 * Effect::getTraceState() */
+	float state;
+};
+
+struct effect_trace_header_s {
+	/* Records following the header */
+	uint32_t count;
+	/* Records lost to a full ring since the previous read */
+	uint32_t dropped;
+};
+
+/* Ring of the last process() calls of one effect, read through the
+ * commands above.
+ *
+ * Single producer, single consumer: process() on the audio thread
+ * appends, command() on the binder thread reads, neither waits for the
+ * other. When the reader falls behind the new records are dropped and
+ * counted, so what is read is always a contiguous stretch. */
+class EffectTrace {
+	effect_trace_record_s mRecords[EFFECT_TRACE_SIZE];
+
+	/* Producer and consumer positions, on lines of their own */
+	alignas(64) std::atomic<uint32_t> mWrite;
+	std::atomic<uint32_t> mDropped;
+	alignas(64) std::atomic<uint32_t> mRead;
+	uint32_t mDroppedRead;
+	uint32_t mGenerationRead;
+
+	/* Written by the binder thread, read by the audio thread */
+	std::atomic<uint32_t> mGeneration;
+
+	/* Tells effects apart in the JSON output */
+	int32_t mId;
+
+	public:
+	EffectTrace();
+	void reset();
+
+	/* Binder thread: parameters or state changed. */
+	void changed();
+	uint32_t generation() const;
+
+	/* Audio thread: one process() call. */
+	void record(int64_t timestamp, int64_t duration, int32_t frames, uint32_t generation, float state);
+
+	/* Binder thread: takes up to capacity of the oldest unread records,
+	 * returns how many. */
+	uint32_t read(effect_trace_record_s* records, uint32_t capacity, uint32_t* dropped);
+
+	/* Binder thread: takes every unread record and prints it to fd as
+	 * events of the Chrome trace event format, which chrome://tracing
+	 * and Perfetto load. The array is left open, as these viewers
+	 * accept, so that several effects can append to one file; it is
+	 * started when the file is empty. */
+	void dumpJson(int fd, const char* name);
+};
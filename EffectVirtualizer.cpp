@@ -21,8 +21,14 @@
 #endif
 
 #include <cmath>
+#include <string.h>
 
+#include "CoefficientCache.h"
 #include "EffectVirtualizer.h"
+#include "Hrtf.h"
+
+/* Head partition of the HRTF convolution, about 1.3 ms at 48 kHz. */
+#define HRTF_PARTITION 64
 
 typedef struct {
 	int32_t status;
@@ -41,9 +47,52 @@ typedef struct {
 } reply1x4_1x2_t;
 
 EffectVirtualizer::EffectVirtualizer()
-	: mStrength(0)
+	: mHrtfRate(0.0)
 {
+	setDefaults();
+}
+
+void EffectVirtualizer::recycle()
+{
+	Effect::recycle();
+	setDefaults();
+}
+
+void EffectVirtualizer::setDefaults()
+{
+	mMode = VIRTUALIZER_MODE_CLASSIC;
+	mLocalization = Biquad();
+	refreshDelays();
+
+	VirtualizerParameters parameters;
+	parameters.strength = 0;
+	parameters.mode = VIRTUALIZER_MODE_CLASSIC;
+	designStrength(parameters);
+	mParameters.reset(parameters);
+
 	refreshStrength();
+	refreshHrtf();
+}
+
+/* Sized for the current rate, 48 kHz until configured, so that
+ * process() never sees an empty delay. */
+void EffectVirtualizer::refreshDelays()
+{
+	/* Haas effect delay -- slight difference between L & R
+	 * to reduce artificialness of the ping-pong. */
+	mReverbDelayL.setParameters(mSamplingRate, 0.029);
+	mReverbDelayR.setParameters(mSamplingRate, 0.023);
+
+	/* the -3 dB point is around 650 Hz, giving about 300 us to work with */
+	mLocalization.setHighShelf(0, 800.0, mSamplingRate, -11.0, 0.72, 0);
+
+	mDelayDataL = 0.0;
+	mDelayDataR = 0.0;
+}
+
+void EffectVirtualizer::commitParameters()
+{
+	mParameters.publish();
 }
 
 int32_t EffectVirtualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData)
@@ -56,16 +105,8 @@ int32_t EffectVirtualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 			return 0;
 		}
 
-		/* Haas effect delay -- slight difference between L & R
-		 * to reduce artificialness of the ping-pong. */
-		mReverbDelayL.setParameters(mSamplingRate, 0.029);
-		mReverbDelayR.setParameters(mSamplingRate, 0.023);
-
-		/* the -3 dB point is around 650 Hz, giving about 300 us to work with */
-		mLocalization.setHighShelf(0, 800.0, mSamplingRate, -11.0, 0.72, 0);
-
-		mDelayDataL = 0.0;
-		mDelayDataR = 0.0;
+		refreshDelays();
+		refreshHrtf();
 
 		int32_t *replyData = (int32_t *) pReplyData;
 		*replyData = 0;
@@ -88,7 +129,15 @@ int32_t EffectVirtualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 				reply1x4_1x2_t *replyData = (reply1x4_1x2_t *) pReplyData;
 				replyData->status = 0;
 				replyData->vsize = 2;
-				replyData->data = mStrength;
+				replyData->data = mParameters.edit().strength;
+				*replySize = sizeof(reply1x4_1x2_t);
+				return 0;
+			}
+			if (cmd == CUSTOM_VIRTUALIZER_PARAM_MODE) {
+				reply1x4_1x2_t *replyData = (reply1x4_1x2_t *) pReplyData;
+				replyData->status = 0;
+				replyData->vsize = 2;
+				replyData->data = mParameters.edit().mode;
 				*replySize = sizeof(reply1x4_1x2_t);
 				return 0;
 			}
@@ -110,12 +159,28 @@ int32_t EffectVirtualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 		if (cep->psize == 4 && cep->vsize == 2) {
 			int32_t cmd = ((int32_t *) cep)[3];
 			if (cmd == VIRTUALIZER_PARAM_STRENGTH) {
-				mStrength = ((int16_t *) cep)[8];
-				refreshStrength();
+				mParameters.edit().strength = ((int16_t *) cep)[8];
+				designStrength(mParameters.edit());
+				publishParameters(mParameters);
 				int32_t *replyData = (int32_t *) pReplyData;
 				*replyData = 0;
 				return 0;
 			}
+			if (cmd == CUSTOM_VIRTUALIZER_PARAM_MODE) {
+				int16_t mode = ((int16_t *) cep)[8];
+				int32_t *replyData = (int32_t *) pReplyData;
+				if (mode != VIRTUALIZER_MODE_CLASSIC && mode != VIRTUALIZER_MODE_HRTF) {
+					*replyData = -EINVAL;
+					return 0;
+				}
+#ifdef DEBUG
+				ALOGI("New mode: %d", mode);
+#endif
+				mParameters.edit().mode = mode;
+				publishParameters(mParameters);
+				*replyData = 0;
+				return 0;
+			}
 		}
 
 #ifdef DEBUG
@@ -130,112 +195,171 @@ int32_t EffectVirtualizer::command(uint32_t cmdCode, uint32_t cmdSize, void* pCm
 	return Effect::command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
 }
 
-void EffectVirtualizer::refreshStrength()
+/* Runs on the command thread. */
+void EffectVirtualizer::designStrength(VirtualizerParameters& parameters)
 {
-	mDeep = mStrength != 0;
-	mWide = mStrength >= 500;
-
-	if (mStrength != 0) {
+	if (parameters.strength != 0) {
 		double start = -15.0;
 		double end = -5.0;
-		double attenuation = start + (end - start) * (mStrength / 1000.0);
+		double attenuation = start + (end - start) * (parameters.strength / 1000.0);
 		double roomEcho = powf(10.0, attenuation / 20.0);
-		mLevel = int64_t(roomEcho * (int64_t(1) << 32));
+		parameters.level = int64_t(roomEcho * (int64_t(1) << 32));
 	} else {
-		mLevel = 0;
+		parameters.level = 0;
 	}
 }
 
-int32_t EffectVirtualizer::process(audio_buffer_t* in, audio_buffer_t* out)
+/* Runs on the audio thread, between buffers. */
+void EffectVirtualizer::refreshStrength()
 {
+	const VirtualizerParameters& parameters = mParameters.current();
+	mDeep = parameters.strength != 0;
+	mWide = parameters.strength >= 500;
+	mLevel = parameters.level;
+}
 
-	double dryL = 0.0, dryR = 0.0, dataL = 0.0, dataR = 0.0;
-	for (uint32_t i = 0; i < in->frameCount; i ++) {
-
-		/* calculate reverb wet into dataL, dataR */
-		if (formatFloatModeInt32Mode == 0) {
-			dryL = read(in, i << 1);
-			dryR = read(in, (i << 1) + 1);
-		}
-		else if (formatFloatModeInt32Mode == 1) {
-			dryL = readPcmFloat(in, i << 1);
-			dryR = readPcmFloat(in, (i << 1) + 1);
-		}
-		else if (formatFloatModeInt32Mode == 2) {
-			dryL = (double)in->s32[i << 1];
-			dryR = (double)in->s32[(i << 1) + 1];
+/* Shuffler form of the speaker pair: the center is convolved with
+ * ipsilateral + contralateral response, the side with their difference.
+ * That is two convolutions instead of four. Sessions at the same rate
+ * share the designed responses through CoefficientCache. */
+static android::sp<ConvolverResponse> hrtfResponse(int32_t kind, double samplingRate)
+{
+	CoefficientKey key = { kind, int32_t(samplingRate), HRTF_PARTITION };
+	android::sp<android::VirtualLightRefBase> set = CoefficientCache::find(key);
+	if (set.get() == NULL) {
+		float ipsilateral[HRTF_LENGTH * 4];
+		float contralateral[HRTF_LENGTH * 4];
+		int32_t length = hrtfResample(hrtfIpsilateral, samplingRate, ipsilateral, HRTF_LENGTH * 4);
+		hrtfResample(hrtfContralateral, samplingRate, contralateral, HRTF_LENGTH * 4);
+
+		float response[HRTF_LENGTH * 4];
+		for (int32_t i = 0; i < length; i ++) {
+			if (kind == COEFFICIENT_HRTF_MID) {
+				response[i] = ipsilateral[i] + contralateral[i];
+			} else {
+				response[i] = ipsilateral[i] - contralateral[i];
+			}
 		}
 
-		dataL = dryL;
-		dataR = dryR;
+		set = CoefficientCache::insert(key, new ConvolverResponse(response, length, HRTF_PARTITION));
+	}
+	return static_cast<ConvolverResponse*>(set.get());
+}
 
-		if (mDeep) {
-			/* Note: a pinking filter here would be good. */
-			dataL += mDelayDataR;
-			dataR += mDelayDataL;
-		}
+void EffectVirtualizer::refreshHrtf()
+{
+	/* Rebuilding the convolvers allocates, so an unchanged rate only
+	 * clears their history. */
+	if (mHrtfRate == mSamplingRate) {
+		mHrtfMid.reset();
+		mHrtfSide.reset();
+		return;
+	}
+	mHrtfRate = mSamplingRate;
 
-		dataL = mReverbDelayL.process(dataL);
-		dataR = mReverbDelayR.process(dataR);
+	mHrtfMid.setResponse(hrtfResponse(COEFFICIENT_HRTF_MID, mSamplingRate));
+	mHrtfSide.setResponse(hrtfResponse(COEFFICIENT_HRTF_SIDE, mSamplingRate));
+}
 
-		if (mWide) {
-			dataR = -dataR;
+/* Only the front pair is virtualized; other channels pass through. */
+int32_t EffectVirtualizer::processPlanes(double* const* planes, int32_t frames)
+{
+	if (mParameters.consume()) {
+		refreshStrength();
+		/* Entering either mode starts from silent convolver history. */
+		if (mParameters.current().mode != mMode) {
+			mHrtfMid.reset();
+			mHrtfSide.reset();
+			mMode = mParameters.current().mode;
 		}
+	}
 
-		dataL = dataL * mLevel / 4294967296.0;
-		dataR = dataR * mLevel / 4294967296.0;
-
-		mDelayDataL = dataL;
-		mDelayDataR = dataR;
+	double wetL[VIRTUALIZER_BLOCK], wetR[VIRTUALIZER_BLOCK];
+	double inL[VIRTUALIZER_BLOCK], inR[VIRTUALIZER_BLOCK];
+	double center[VIRTUALIZER_BLOCK], side[VIRTUALIZER_BLOCK];
 
-		/* Reverb wet done; mix with dry and do headphone virtualization */
-		dataL += dryL;
-		dataR += dryR;
+	/* The feedback path runs through delays longer than a block, so every
+	 * delay output a block needs was written by an earlier block. That
+	 * lets each stage below run as a pass over the whole block. */
+	int32_t blockLimit = VIRTUALIZER_BLOCK;
+	if (mReverbDelayL.getLength() < blockLimit) {
+		blockLimit = mReverbDelayL.getLength();
+	}
+	if (mReverbDelayR.getLength() < blockLimit) {
+		blockLimit = mReverbDelayR.getLength();
+	}
 
-		if (formatFloatModeInt32Mode == 0) {
-			/* Center channel. */
-			int32_t center  = (dataL + dataR) / 2;
-			/* Direct radiation components. */
-			int32_t side = (dataL - dataR) / 2;
+	for (int32_t start = 0; start < frames; start += blockLimit) {
+		int32_t n = frames - start < blockLimit ? frames - start : blockLimit;
+		double* dryL = planes[0] + start;
+		double* dryR = planes[1] + start;
 
-			/* Adjust derived center channel coloration to emphasize forward
-			 * direction impression. (XXX: disabled until configurable). */
-			//center = mColorization.process(center);
-			/* Sound reaching ear from the opposite speaker */
-			side -= mLocalization.process(side);
+		/* calculate reverb wet into wetL, wetR */
+		mReverbDelayL.read(wetL, n);
+		mReverbDelayR.read(wetR, n);
 
-			write(out, i << 1, center + side);
-			write(out, (i << 1) + 1, center - side);
+		double signR = mWide ? -1.0 : 1.0;
+		for (int32_t j = 0; j < n; j ++) {
+			wetL[j] = wetL[j] * mLevel / 4294967296.0;
+			wetR[j] = signR * wetR[j] * mLevel / 4294967296.0;
 		}
-		else if (formatFloatModeInt32Mode == 1) {
-			/* Center channel. */
-			double center = (dataL + dataR) / 2;
-			/* Direct radiation components. */
-			double side = (dataL - dataR) / 2;
-			
-			/* Adjust derived center channel coloration to emphasize forward
-			 * direction impression. (XXX: disabled until configurable). */
-			//center = mColorization.process(center);
-			/* Sound reaching ear from the opposite speaker */
-			side -= mLocalization.process(side);
 
-			writePcmFloat(out, i << 1, center + side);
-			writePcmFloat(out, (i << 1) + 1, center - side);
+		/* Delay inputs. The crossed feedback lags by one more frame. */
+		if (mDeep) {
+			/* Note: a pinking filter here would be good. */
+			inL[0] = dryL[0] + mDelayDataR;
+			inR[0] = dryR[0] + mDelayDataL;
+			for (int32_t j = 1; j < n; j ++) {
+				inL[j] = dryL[j] + wetR[j - 1];
+				inR[j] = dryR[j] + wetL[j - 1];
+			}
+		} else {
+			memcpy(inL, dryL, n * sizeof(double));
+			memcpy(inR, dryR, n * sizeof(double));
 		}
-		else if (formatFloatModeInt32Mode == 2) {
-			/* Center channel. */
-			double center = (dataL + dataR) / 2;
-			/* Direct radiation components. */
-			double side = (dataL - dataR) / 2;
-			
-			/* Adjust derived center channel coloration to emphasize forward
-			 * direction impression. (XXX: disabled until configurable). */
-			//center = mColorization.process(center);
+		mReverbDelayL.write(inL, n);
+		mReverbDelayR.write(inR, n);
+
+		mDelayDataL = wetL[n - 1];
+		mDelayDataR = wetR[n - 1];
+
+		/* Reverb wet done; mix with dry and do headphone virtualization.
+		 * Center channel and direct radiation components. */
+		for (int32_t j = 0; j < n; j ++) {
+			double dataL = wetL[j] + dryL[j];
+			double dataR = wetR[j] + dryR[j];
+			center[j] = (dataL + dataR) / 2;
+			side[j] = (dataL - dataR) / 2;
+		}
+
+		/* Adjust derived center channel coloration to emphasize forward
+		 * direction impression. (XXX: disabled until configurable). */
+		//mColorization.process(center, center, n);
+
+		if (mMode == VIRTUALIZER_MODE_HRTF) {
+			for (int32_t j = 0; j < n; j ++) {
+				mMid[j] = float(center[j]);
+				mSide[j] = float(side[j]);
+			}
+			mHrtfMid.process(mMid, mMid, n);
+			mHrtfSide.process(mSide, mSide, n);
+			for (int32_t j = 0; j < n; j ++) {
+				center[j] = mMid[j];
+				side[j] = mSide[j];
+			}
+		} else {
 			/* Sound reaching ear from the opposite speaker */
-			side -= mLocalization.process(side);
-			
-			out->s32[i << 1] = (int32_t)(center + side);
-			out->s32[(i << 1) + 1] = (int32_t)(center - side);
+			mLocalization.process(side, inL, n);
+			for (int32_t j = 0; j < n; j ++) {
+				side[j] -= inL[j];
+			}
+		}
+
+		/* Decode back to left and right. The dry front pair is no
+		 * longer needed, so the result replaces it. */
+		for (int32_t j = 0; j < n; j ++) {
+			dryL[j] = center[j] + side[j];
+			dryR[j] = center[j] - side[j];
 		}
 	}
 
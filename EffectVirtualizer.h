@@ -3,13 +3,31 @@
 #include "system/audio_effects/effect_virtualizer.h"
 
 #include "Biquad.h"
+#include "Convolver.h"
 #include "Delay.h"
 #include "Effect.h"
 #include "FIR16.h"
+#include "ParameterBuffer.h"
+
+#define CUSTOM_VIRTUALIZER_PARAM_MODE 1000
+
+#define VIRTUALIZER_MODE_CLASSIC 0
+#define VIRTUALIZER_MODE_HRTF 1
+
+/* Frames per block pass in processPlanes(). */
+#define VIRTUALIZER_BLOCK 256
+
+/* Set by command(), applied by process() at the next buffer. */
+struct VirtualizerParameters {
+	int16_t strength;
+	int16_t mode;
+	/* Room echo level, 32.32, derived from strength by command() */
+	int64_t level;
+};
 
 class EffectVirtualizer : public Effect {
 	private:
-	int16_t mStrength;
+	ParameterBuffer<VirtualizerParameters> mParameters;
 
 	bool mDeep, mWide;
 	int64_t mLevel;
@@ -18,11 +36,24 @@ class EffectVirtualizer : public Effect {
 	double mDelayDataL, mDelayDataR;
 	Biquad mLocalization;
 
+	/* Mode in use by process() */
+	int16_t mMode;
+	/* Rate the HRTF convolvers were built for */
+	double mHrtfRate;
+	Convolver mHrtfMid, mHrtfSide;
+	float mMid[VIRTUALIZER_BLOCK], mSide[VIRTUALIZER_BLOCK];
+
+	void setDefaults();
+	void refreshDelays();
+	static void designStrength(VirtualizerParameters& parameters);
 	void refreshStrength();
+	void refreshHrtf();
+	void commitParameters();
 
 	public:
 	EffectVirtualizer();
+	void recycle();
 
 	int32_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData, uint32_t* replySize, void* pReplyData);
-	int32_t process(audio_buffer_t *in, audio_buffer_t *out);
+	int32_t processPlanes(double* const* planes, int32_t frames);
 };
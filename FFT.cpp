@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FFT.h"
+#include "Simd.h"
+
+#include <cmath>
+
+template <typename V> static inline V load(const float* p);
+
+template <> inline float load<float>(const float* p)
+{
+	return *p;
+}
+
+template <> inline v4sf load<v4sf>(const float* p)
+{
+	return loadV4(p);
+}
+
+static inline void store(float* p, float v)
+{
+	*p = v;
+}
+
+static inline void store(float* p, v4sf v)
+{
+	storeV4(p, v);
+}
+
+/* Two radix-2 levels fused into a single pass over the four quarters of
+ * a group: three complex multiplies per four points, as in radix-4, while
+ * keeping the plain bit reversed ordering. */
+template <typename V, bool inverse>
+static inline void butterfly(float* re, float* im, int32_t a, int32_t h, V w1r, V w1i, V w2r, V w2i)
+{
+	if (inverse) {
+		w1i = -w1i;
+		w2i = -w2i;
+	}
+
+	V x0r = load<V>(re + a), x0i = load<V>(im + a);
+	V x1r = load<V>(re + a + h), x1i = load<V>(im + a + h);
+	V x2r = load<V>(re + a + 2 * h), x2i = load<V>(im + a + 2 * h);
+	V x3r = load<V>(re + a + 3 * h), x3i = load<V>(im + a + 3 * h);
+
+	V t1r = x1r * w1r - x1i * w1i, t1i = x1r * w1i + x1i * w1r;
+	V t3r = x3r * w1r - x3i * w1i, t3i = x3r * w1i + x3i * w1r;
+
+	V y0r = x0r + t1r, y0i = x0i + t1i;
+	V y1r = x0r - t1r, y1i = x0i - t1i;
+	V y2r = x2r + t3r, y2i = x2i + t3i;
+	V y3r = x2r - t3r, y3i = x2i - t3i;
+
+	V ur = y2r * w2r - y2i * w2i, ui = y2r * w2i + y2i * w2r;
+	V tr = y3r * w2r - y3i * w2i, ti = y3r * w2i + y3i * w2r;
+
+	/* W(4h)^h is -i going forward and +i going back. */
+	V vr = inverse ? -ti : ti;
+	V vi = inverse ? tr : -tr;
+
+	store(re + a, y0r + ur);
+	store(im + a, y0i + ui);
+	store(re + a + 2 * h, y0r - ur);
+	store(im + a + 2 * h, y0i - ui);
+	store(re + a + h, y1r + vr);
+	store(im + a + h, y1i + vi);
+	store(re + a + 3 * h, y1r - vr);
+	store(im + a + 3 * h, y1i - vi);
+}
+
+FFT::FFT()
+	: mSize(0), mHalf(0), mStages(0), mBitReverse(0), mTwiddles(0),
+		mSplitCos(0), mSplitSin(0), mWorkRe(0), mWorkIm(0)
+{
+}
+
+FFT::~FFT()
+{
+	release();
+}
+
+void FFT::release()
+{
+	delete[] mBitReverse;
+	alignedDelete(mTwiddles);
+	alignedDelete(mSplitCos);
+	alignedDelete(mSplitSin);
+	alignedDelete(mWorkRe);
+	alignedDelete(mWorkIm);
+	mBitReverse = 0;
+	mTwiddles = 0;
+	mSplitCos = mSplitSin = 0;
+	mWorkRe = mWorkIm = 0;
+	mSize = mHalf = mStages = 0;
+}
+
+void FFT::setSize(int32_t size)
+{
+	if (size == mSize) {
+		return;
+	}
+	release();
+
+	/* The real transform runs as a complex transform of half the size. */
+	mSize = size;
+	mHalf = size / 2;
+
+	mStages = 0;
+	while ((1 << mStages) < mHalf) {
+		mStages ++;
+	}
+	mBitReverse = new int32_t[mHalf];
+	for (int32_t i = 0; i < mHalf; i ++) {
+		int32_t r = 0;
+		for (int32_t b = 0; b < mStages; b ++) {
+			r |= ((i >> b) & 1) << (mStages - 1 - b);
+		}
+		mBitReverse[i] = r;
+	}
+
+	/* Per fused pass of quarter size h: W(2h)^k and W(4h)^k for k < h,
+	 * stored contiguously so the kernels can load them as vectors. */
+	mTwiddles = alignedNew<float>(mHalf * 4);
+	float* tw = mTwiddles;
+	for (int32_t h = (mStages & 1) ? 2 : 1; h < mHalf; h *= 4) {
+		for (int32_t k = 0; k < h; k ++) {
+			tw[k] = float(cos(M_PI * k / h));
+			tw[h + k] = float(-sin(M_PI * k / h));
+			tw[2 * h + k] = float(cos(M_PI * k / (2 * h)));
+			tw[3 * h + k] = float(-sin(M_PI * k / (2 * h)));
+		}
+		tw += 4 * h;
+	}
+
+	mSplitCos = alignedNew<float>(mHalf);
+	mSplitSin = alignedNew<float>(mHalf);
+	for (int32_t k = 0; k < mHalf; k ++) {
+		mSplitCos[k] = float(cos(2 * M_PI * k / mSize));
+		mSplitSin[k] = float(sin(2 * M_PI * k / mSize));
+	}
+
+	mWorkRe = alignedNew<float>(mHalf);
+	mWorkIm = alignedNew<float>(mHalf);
+}
+
+int32_t FFT::getSize() const
+{
+	return mSize;
+}
+
+/* Complex transform of mHalf points in mWork, which must already be in
+ * bit reversed order. */
+template <bool inverse>
+void FFT::transform()
+{
+	float* re = mWorkRe;
+	float* im = mWorkIm;
+	int32_t h = 1;
+
+	/* An odd number of levels leaves one plain radix-2 pass. */
+	if (mStages & 1) {
+		for (int32_t a = 0; a < mHalf; a += 2) {
+			float tr = re[a + 1];
+			float ti = im[a + 1];
+			re[a + 1] = re[a] - tr;
+			im[a + 1] = im[a] - ti;
+			re[a] += tr;
+			im[a] += ti;
+		}
+		h = 2;
+	}
+
+	const float* tw = mTwiddles;
+	for (; h < mHalf; h *= 4) {
+		if (h < 4) {
+			for (int32_t s = 0; s < mHalf; s += 4 * h) {
+				for (int32_t k = 0; k < h; k ++) {
+					butterfly<float, inverse>(re, im, s + k, h,
+							tw[k], tw[h + k], tw[2 * h + k], tw[3 * h + k]);
+				}
+			}
+		} else {
+			for (int32_t s = 0; s < mHalf; s += 4 * h) {
+				for (int32_t k = 0; k < h; k += 4) {
+					butterfly<v4sf, inverse>(re, im, s + k, h,
+							loadV4(tw + k), loadV4(tw + h + k),
+							loadV4(tw + 2 * h + k), loadV4(tw + 3 * h + k));
+				}
+			}
+		}
+		tw += 4 * h;
+	}
+}
+
+void FFT::forward(const float* in, float* re, float* im)
+{
+	/* Pack even samples to real and odd samples to imaginary part,
+	 * permuting into bit reversed order on the way. */
+	for (int32_t n = 0; n < mHalf; n ++) {
+		int32_t r = mBitReverse[n];
+		mWorkRe[n] = in[2 * r];
+		mWorkIm[n] = in[2 * r + 1];
+	}
+	transform<false>();
+
+	/* Split the packed spectrum into the even and odd halves and
+	 * recombine them into the spectrum of the real signal. */
+	re[0] = mWorkRe[0] + mWorkIm[0];
+	im[0] = mWorkRe[0] - mWorkIm[0];
+	for (int32_t k = 1; k < mHalf; k ++) {
+		float zr = mWorkRe[k];
+		float zi = mWorkIm[k];
+		float cr = mWorkRe[mHalf - k];
+		float ci = -mWorkIm[mHalf - k];
+
+		float evenR = (zr + cr) * 0.5f;
+		float evenI = (zi + ci) * 0.5f;
+		float oddR = (zi - ci) * 0.5f;
+		float oddI = (cr - zr) * 0.5f;
+
+		float c = mSplitCos[k];
+		float s = mSplitSin[k];
+		re[k] = evenR + oddR * c + oddI * s;
+		im[k] = evenI + oddI * c - oddR * s;
+	}
+}
+
+void FFT::forward(float* data)
+{
+	forward(data, data, data + mHalf);
+}
+
+void FFT::inverse(const float* re, const float* im, float* out)
+{
+	mWorkRe[0] = (re[0] + im[0]) * 0.5f;
+	mWorkIm[0] = (re[0] - im[0]) * 0.5f;
+	for (int32_t k = 1; k < mHalf; k ++) {
+		float xr = re[k];
+		float xi = im[k];
+		float cr = re[mHalf - k];
+		float ci = -im[mHalf - k];
+
+		float evenR = (xr + cr) * 0.5f;
+		float evenI = (xi + ci) * 0.5f;
+		float dr = (xr - cr) * 0.5f;
+		float di = (xi - ci) * 0.5f;
+
+		float c = mSplitCos[k];
+		float s = mSplitSin[k];
+		float oddR = dr * c - di * s;
+		float oddI = dr * s + di * c;
+
+		int32_t r = mBitReverse[k];
+		mWorkRe[r] = evenR - oddI;
+		mWorkIm[r] = evenI + oddR;
+	}
+	transform<true>();
+
+	float scale = 1.0f / mHalf;
+	for (int32_t n = 0; n < mHalf; n ++) {
+		out[2 * n] = mWorkRe[n] * scale;
+		out[2 * n + 1] = mWorkIm[n] * scale;
+	}
+}
+
+void FFT::inverse(float* data)
+{
+	inverse(data, data + mHalf, data);
+}
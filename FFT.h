@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Real-input FFT for power-of-two sizes, tuned for 64 .. 16384.
+ *
+ * Spectra are kept in split form, re[0 .. N/2) and im[0 .. N/2). DC and
+ * Nyquist are both purely real, so the Nyquist bin is stored in im[0].
+ * The in-place variants use the first half of the array for re and the
+ * second half for im. All buffers should come from alignedNew(). */
+class FFT {
+	int32_t mSize;
+	int32_t mHalf;
+	int32_t mStages;
+	int32_t* mBitReverse;
+	float* mTwiddles;
+	float* mSplitCos;
+	float* mSplitSin;
+	float* mWorkRe;
+	float* mWorkIm;
+
+	void release();
+	template <bool inverse> void transform();
+
+	public:
+	FFT();
+	~FFT();
+	void setSize(int32_t size);
+	int32_t getSize() const;
+	void forward(const float* in, float* re, float* im);
+	void forward(float* data);
+	void inverse(const float* re, const float* im, float* out);
+	void inverse(float* data);
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/* Polynomial approximations for control-rate level math, good to about
+ * 1e-4 dB. fastLog2() takes positive finite input; fastExp2() flushes to
+ * zero below 2^-1022. */
+inline double fastLog2(double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int32_t exponent = int32_t((bits >> 52) & 0x7ff) - 1023;
+	bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+	double mantissa;
+	memcpy(&mantissa, &bits, sizeof(mantissa));
+
+	/* log2(1 + f) for f in [0, 1) */
+	double f = mantissa - 1.0;
+	return exponent + f * (1.4418258726 + f * (-0.7086829230 + f * (0.4154247222
+			+ f * (-0.1944263689 + f * 0.0458872202))));
+}
+
+inline double fastExp2(double x)
+{
+	if (x < -1022.0) {
+		return 0.0;
+	}
+	int32_t i = int32_t(x);
+	if (i > x) {
+		i --;
+	}
+
+	/* 2^f for f in [0, 1) */
+	double f = x - i;
+	double p = 1.0 + f * (0.6931527446 + f * (0.2401531998 + f * (0.0558281562
+			+ f * (0.0089889911 + f * 0.0018766267))));
+
+	uint64_t bits;
+	memcpy(&bits, &p, sizeof(bits));
+	bits += uint64_t(int64_t(i)) << 52;
+	memcpy(&p, &bits, sizeof(p));
+	return p;
+}
+
+inline double fastDb(double power)
+{
+	/* 10 * log10(2) */
+	return fastLog2(power) * 3.0102999566;
+}
+
+inline double fastDbToGain(double dB)
+{
+	/* log2(10) / 20 */
+	return fastExp2(dB * 0.1660964047);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Sample type of the planar buffers used by the integer-capable effects.
+ *
+ * With DSP_FIXED_POINT (TARGET_DSP_FIXED_POINT in Android.mk) these are
+ * int32 at the same 2^23 full scale as the double path, which leaves 8
+ * bits of headroom. Gains stay 8.24 and
+ * biquads run with Q2.30 feedback coefficients and 64-bit accumulators,
+ * so the per-sample work needs no floating point at all. */
+#ifdef DSP_FIXED_POINT
+typedef int32_t sample_t;
+#else
+typedef double sample_t;
+#endif
+
+#define FIXED_SAMPLE_BITS 23
+
+inline int32_t saturate32(int64_t x)
+{
+	if (x > INT32_MAX) {
+		return INT32_MAX;
+	}
+	if (x < INT32_MIN) {
+		return INT32_MIN;
+	}
+	return int32_t(x);
+}
+
+/* Sample times 8.24 gain */
+inline double mulQ24(double x, int32_t gain)
+{
+	return x * gain / 16777216.0;
+}
+
+inline int32_t mulQ24(int32_t x, int32_t gain)
+{
+	return saturate32((int64_t(x) * gain) >> 24);
+}
+
+#ifdef DSP_FIXED_POINT
+/* Between the double planes EffectChain shares and the integer engine */
+inline void samplesFromDouble(const double* in, int32_t* out, int32_t frames)
+{
+	for (int32_t i = 0; i < frames; i ++) {
+		double x = in[i];
+		out[i] = saturate32(int64_t(x < 0 ? x - 0.5 : x + 0.5));
+	}
+}
+
+inline void samplesToDouble(const int32_t* in, double* out, int32_t frames)
+{
+	for (int32_t i = 0; i < frames; i ++) {
+		out[i] = in[i];
+	}
+}
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Hrtf.h"
+
+const float hrtfIpsilateral[HRTF_LENGTH] = {
+	-6.94316578e-04f, 9.16000690e-04f, -1.33994236e-03f, 2.45001571e-03f, 6.57571527e-01f, -2.63643929e-02f,
+	-1.88412311e-02f, -1.81067345e-02f, -1.38791766e-02f, -1.29523500e-02f, -1.00481081e-02f, -9.33962343e-03f,
+	-7.23407245e-03f, -6.75989482e-03f, -5.19018021e-03f, -4.90659321e-03f, -3.71206302e-03f, -3.57138724e-03f,
+	-2.64555126e-03f, -2.60777966e-03f, -1.87722955e-03f, -1.91143587e-03f, -1.32445725e-03f, -1.40762399e-03f,
+	-9.27284666e-04f, -1.04265787e-03f, -6.42325976e-04f, -7.77904424e-04f, -4.38227506e-04f, -5.85532584e-04f,
+	-2.92352417e-04f, -4.45477510e-04f, -1.88368770e-04f, -3.43264738e-04f, -1.14500217e-04f, -2.68447241e-04f,
+	-6.22596544e-05f, -2.13481183e-04f, -2.55335901e-05f, -1.72916490e-04f, 7.93715077e-08f, -1.42813698e-04f,
+	1.77461630e-05f, -1.20323614e-04f, 2.97439694e-05f, -1.03384219e-04f, 3.77089225e-05f, -9.05020360e-05f,
+	4.28154640e-05f, -8.05943828e-05f, 4.59056675e-05f, -7.28755204e-05f, 4.75824552e-05f, -6.67744609e-05f,
+	4.82767684e-05f, -6.18756147e-05f, 4.82959563e-05f, -5.78759160e-05f, 4.78586209e-05f, -5.45538418e-05f,
+	4.71197006e-05f, -5.17470164e-05f, 4.61885190e-05f, -4.93360154e-05f, 4.51417638e-05f, -4.72326456e-05f,
+	4.40328152e-05f, -4.53714608e-05f, 4.28984462e-05f, -4.37036135e-05f, 4.17636292e-05f, -4.21923977e-05f,
+	4.04711204e-05f, -4.01147287e-05f, 3.80478298e-05f, -3.68868533e-05f, 3.45175626e-05f, -3.27351262e-05f,
+	3.01433589e-05f, -2.79347466e-05f, 2.52284453e-05f, -2.27904850e-05f, 2.00947925e-05f, -1.76162097e-05f,
+	1.50618384e-05f, -1.27146137e-05f, 1.04265474e-05f, -8.35845808e-06f, 6.44587761e-06f, -4.77447981e-06f,
+	3.32256849e-06f, -2.13088639e-06f, 1.19494443e-06f, -5.29085150e-07f, 1.31179529e-07f, -0.00000000e+00f,
+};
+
+const float hrtfContralateral[HRTF_LENGTH] = {
+	2.67618325e-03f, -2.84921721e-03f, 3.04611131e-03f, -3.27217053e-03f, 3.53439825e-03f, -3.84223504e-03f,
+	4.20871970e-03f, -4.65238384e-03f, 5.20048417e-03f, -5.89482100e-03f, 6.80292743e-03f, -8.04146073e-03f,
+	9.83075227e-03f, -1.26426712e-02f, 1.77016391e-02f, -2.94643753e-02f, 8.61675481e-02f, 1.45037014e-01f,
+	1.67477459e-02f, 5.68104123e-02f, 2.06902761e-02f, 3.80643312e-02f, 1.59894260e-02f, 2.71753788e-02f,
+	1.14354920e-02f, 1.98976934e-02f, 7.84725680e-03f, 1.48107620e-02f, 5.17379051e-03f, 1.11819776e-02f,
+	3.23135705e-03f, 8.56237004e-03f, 1.84210405e-03f, 6.65499800e-03f, 8.61255583e-04f, 5.25601239e-03f,
+	1.77781346e-04f, 4.22263158e-03f, -2.91170950e-04f, 3.45365337e-03f, -6.06511385e-04f, 2.87679577e-03f,
+	-8.12604813e-04f, 2.44015400e-03f, -9.41554966e-04f, 2.10630163e-03f, -1.01647380e-03f, 1.84815835e-03f,
+	-1.05392460e-03f, 1.64606821e-03f, -1.06572510e-03f, 1.48572039e-03f, -1.06026765e-03f, 1.35666272e-03f,
+	-1.04348055e-03f, 1.25123546e-03f, -1.01952513e-03f, 1.16380429e-03f, -9.91299729e-04f, 1.09020746e-03f,
+	-9.60802950e-04f, 1.02735632e-03f, -9.29394931e-04f, 9.72946348e-04f, -8.97984761e-04f, 9.25247555e-04f,
+	-8.67164604e-04f, 8.82952318e-04f, -8.37305444e-04f, 8.45064609e-04f, -8.08625206e-04f, 8.10819223e-04f,
+	-7.77895282e-04f, 7.66340246e-04f, -7.26441168e-04f, 7.00702145e-04f, -6.54987180e-04f, 6.18496497e-04f,
+	-5.68725102e-04f, 5.25103623e-04f, -4.73467568e-04f, 4.26327216e-04f, -3.75251988e-04f, 3.28018764e-04f,
+	-2.79957044e-04f, 2.35715614e-04f, -1.92951599e-04f, 1.54314595e-04f, -1.18793683e-04f, 8.77998242e-05f,
+	-6.09941011e-05f, 3.90391404e-05f, -2.18552077e-05f, 9.65869010e-06f, -2.39083730e-06f, 0.00000000e+00f,
+};
+
+int32_t hrtfResample(const float* ir, double samplingRate, float* out, int32_t maxLength)
+{
+	double step = HRTF_SAMPLING_RATE / samplingRate;
+	int32_t length = int32_t(HRTF_LENGTH / step);
+	if (length > maxLength) {
+		length = maxLength;
+	}
+
+	/* Linear interpolation is enough for these smooth responses. The
+	 * gain factor keeps the frequency response level across rates. */
+	for (int32_t i = 0; i < length; i ++) {
+		double position = i * step;
+		int32_t idx = int32_t(position);
+		double frac = position - idx;
+		double a = ir[idx];
+		double b = idx + 1 < HRTF_LENGTH ? ir[idx + 1] : 0.0;
+		out[i] = float((a + (b - a) * frac) * step);
+	}
+
+	return length;
+}
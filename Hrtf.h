@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Spherical head model (Brown & Duda) responses for a speaker pair at
+ * +-30 degrees: head shadow plus Woodworth interaural delay, sampled at
+ * 48 kHz and normalized to unity gain at DC for a centered source. */
+#define HRTF_LENGTH 96
+#define HRTF_SAMPLING_RATE 48000.0
+
+extern const float hrtfIpsilateral[HRTF_LENGTH];
+extern const float hrtfContralateral[HRTF_LENGTH];
+
+/* Resample a table response to samplingRate. Returns the new length. */
+int32_t hrtfResample(const float* ir, double samplingRate, float* out, int32_t maxLength);
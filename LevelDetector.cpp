@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LevelDetector.h"
+#include "Simd.h"
+
+#include <string.h>
+
+LevelDetector::LevelDetector()
+	: mScale(1.0), mSmoothing(1.0), mSum(0), mCount(0), mLevel(0)
+{
+}
+
+/* Magnitude of a full scale sample, PCM_FULL_SCALE for planar buffers. */
+void LevelDetector::setFullScale(double fullScale)
+{
+	mScale = 1.0 / (fullScale * fullScale);
+}
+
+/* Weight of the newest window in the average, 0 .. 1. */
+void LevelDetector::setSmoothing(double smoothing)
+{
+	mSmoothing = smoothing;
+}
+
+void LevelDetector::accumulate(const double* in, int32_t frames)
+{
+	mSum += sumOfSquares(in, frames);
+	mCount += frames;
+}
+
+#ifdef DSP_FIXED_POINT
+/* Exact in 64 bits for blocks of up to 2^16 frames at up to 2^23 peak,
+ * the sample full scale of the integer engine. */
+void LevelDetector::accumulate(const int32_t* in, int32_t frames)
+{
+	int64_t sum = 0;
+	for (int32_t i = 0; i < frames; i ++) {
+		sum += int64_t(in[i]) * in[i];
+	}
+	mSum += double(sum);
+	mCount += frames;
+}
+#endif
+
+double LevelDetector::update()
+{
+	if (mCount != 0) {
+		double level = mSum / mCount * mScale;
+		mLevel += (level - mLevel) * mSmoothing;
+	}
+	mSum = 0;
+	mCount = 0;
+	return mLevel;
+}
+
+double LevelDetector::getLevel() const
+{
+	return mLevel;
+}
+
+void LevelDetector::setLevel(double level)
+{
+	mLevel = level;
+}
+
+void LevelDetector::reset()
+{
+	mSum = 0;
+	mCount = 0;
+	mLevel = 0;
+}
+
+double LevelDetector::sumOfSquares(const double* in, int32_t frames)
+{
+	v4df sum0 = { 0, 0, 0, 0 };
+	v4df sum1 = { 0, 0, 0, 0 };
+	int32_t i = 0;
+	for (; i + 8 <= frames; i += 8) {
+		/* Unaligned loads */
+		v4df a, b;
+		memcpy(&a, in + i, sizeof(a));
+		memcpy(&b, in + i + 4, sizeof(b));
+		sum0 += a * a;
+		sum1 += b * b;
+	}
+	sum0 += sum1;
+	double sum = (sum0[0] + sum0[1]) + (sum0[2] + sum0[3]);
+	for (; i < frames; i ++) {
+		sum += in[i] * in[i];
+	}
+	return sum;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Mean square level of one channel, relative to full scale: a full scale
+ * square wave reads 1.0 in every sample format.
+ *
+ * Blocks are summed with SIMD as they arrive. update() closes the current
+ * window and folds its mean into an exponential average; with smoothing
+ * 1.0 the result is the plain mean over the window. */
+class LevelDetector {
+	double mScale;
+	double mSmoothing;
+	double mSum;
+	int32_t mCount;
+	double mLevel;
+
+	public:
+	LevelDetector();
+	void setFullScale(double fullScale);
+	void setSmoothing(double smoothing);
+	void accumulate(const double* in, int32_t frames);
+#ifdef DSP_FIXED_POINT
+	void accumulate(const int32_t* in, int32_t frames);
+#endif
+	double update();
+	double getLevel() const;
+	void setLevel(double level);
+	void reset();
+
+	static double sumOfSquares(const double* in, int32_t frames);
+};
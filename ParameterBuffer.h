@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+/* Hands parameter sets from command() on the binder thread to process()
+ * on the audio thread without locks.
+ *
+ * Triple buffered: the writer edits its own copy and publishes it by
+ * swapping it with the shared copy; the reader swaps the shared copy
+ * for its own only when something new was published. Each side owns one
+ * copy at a time, so neither ever waits and the reader never sees a
+ * half written set. One writer and one reader only. */
+template <typename T>
+class ParameterBuffer {
+	/* Shared slot index, and whether it holds an unread set */
+	static const uint32_t INDEX = 3;
+	static const uint32_t FRESH = 4;
+
+	T mSlots[3];
+	std::atomic<uint32_t> mShared;
+	uint32_t mWriter;
+	uint32_t mReader;
+
+	public:
+	ParameterBuffer()
+		: mShared(1), mWriter(0), mReader(2)
+	{
+	}
+
+	/* Sets every copy. Only while process() cannot run, e.g. from the
+	 * effect's constructor. */
+	void reset(const T& value)
+	{
+		for (int32_t i = 0; i < 3; i ++) {
+			mSlots[i] = value;
+		}
+		mShared.store(mShared.load(std::memory_order_relaxed) & INDEX, std::memory_order_relaxed);
+	}
+
+	/* Writer side: the staging copy. It always holds the latest values,
+	 * so command() also answers GET_PARAM from it. */
+	T& edit()
+	{
+		return mSlots[mWriter];
+	}
+
+	/* Writer side: makes the staging copy visible to the reader. */
+	void publish()
+	{
+		uint32_t published = mWriter;
+		mWriter = mShared.exchange(published | FRESH, std::memory_order_acq_rel) & INDEX;
+		mSlots[mWriter] = mSlots[published];
+	}
+
+	/* Reader side: takes the newest published set, if there is one.
+	 * Returns true when current() changed. */
+	bool consume()
+	{
+		if ((mShared.load(std::memory_order_relaxed) & FRESH) == 0) {
+			return false;
+		}
+		mReader = mShared.exchange(mReader, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	/* Reader side: the set taken by the last consume(). */
+	const T& current() const
+	{
+		return mSlots[mReader];
+	}
+};
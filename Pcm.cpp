@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Pcm.h"
+
+#include <atomic>
+#include <cmath>
+
+#include "Cpu.h"
+
+/* One converter per format. The read and write drivers below are
+ * instantiated for each, so their inner loops have no branches on the
+ * format and are plain enough for the compiler to vectorize. */
+namespace {
+
+struct Packed24 {
+	uint8_t b[3];
+};
+
+struct S16 {
+	typedef int16_t Raw;
+	static const bool DITHERED = true;
+
+	static inline void load(Raw x, double& v) {
+		v = x * 256.0;
+	}
+	static inline void load(Raw x, int32_t& v) {
+		v = int32_t(x) * 256;
+	}
+	static inline Raw store(double v, int32_t dither) {
+		v = (v + dither) / 256;
+		if (v > 32767) {
+			v = 32767;
+		}
+		if (v < -32768) {
+			v = -32768;
+		}
+		return Raw(v);
+	}
+	static inline Raw store(int32_t v, int32_t dither) {
+		int32_t x = int32_t((int64_t(v) + dither) >> 8);
+		return Raw(x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+	}
+};
+
+struct S24Packed {
+	typedef Packed24 Raw;
+	static const bool DITHERED = false;
+
+	static inline int32_t unpack(Raw x) {
+		/* Shift up to sign-extend bit 23. */
+		return int32_t(uint32_t(x.b[0]) << 8 | uint32_t(x.b[1]) << 16 | uint32_t(x.b[2]) << 24) >> 8;
+	}
+	static inline Raw pack(int32_t x) {
+		Raw r;
+		r.b[0] = uint8_t(x);
+		r.b[1] = uint8_t(x >> 8);
+		r.b[2] = uint8_t(x >> 16);
+		return r;
+	}
+	static inline void load(Raw x, double& v) {
+		v = unpack(x);
+	}
+	static inline void load(Raw x, int32_t& v) {
+		v = unpack(x);
+	}
+	static inline Raw store(double v, int32_t) {
+		if (v > 8388607.0) {
+			v = 8388607.0;
+		}
+		if (v < -8388608.0) {
+			v = -8388608.0;
+		}
+		return pack(int32_t(v));
+	}
+	static inline Raw store(int32_t v, int32_t) {
+		return pack(v > 8388607 ? 8388607 : v < -8388608 ? -8388608 : v);
+	}
+};
+
+/* Q8.23, already at planar scale. */
+struct S8_24 {
+	typedef int32_t Raw;
+	static const bool DITHERED = false;
+
+	static inline void load(Raw x, double& v) {
+		v = x;
+	}
+	static inline void load(Raw x, int32_t& v) {
+		v = x;
+	}
+	static inline Raw store(double v, int32_t) {
+		if (v > 2147483647.0) {
+			v = 2147483647.0;
+		}
+		if (v < -2147483648.0) {
+			v = -2147483648.0;
+		}
+		return Raw(v);
+	}
+	static inline Raw store(int32_t v, int32_t) {
+		return v;
+	}
+};
+
+struct S32 {
+	typedef int32_t Raw;
+	static const bool DITHERED = false;
+
+	static inline void load(Raw x, double& v) {
+		v = x / 256.0;
+	}
+	static inline void load(Raw x, int32_t& v) {
+		v = x >> 8;
+	}
+	static inline Raw store(double v, int32_t) {
+		v *= 256.0;
+		if (v > 2147483647.0) {
+			v = 2147483647.0;
+		}
+		if (v < -2147483648.0) {
+			v = -2147483648.0;
+		}
+		return Raw(v);
+	}
+	static inline Raw store(int32_t v, int32_t) {
+		return saturate32(int64_t(v) * 256);
+	}
+};
+
+struct Float {
+	typedef float Raw;
+	static const bool DITHERED = false;
+
+	static inline void load(Raw x, double& v) {
+		v = x * PCM_FULL_SCALE;
+	}
+	/* Float may carry headroom; saturate to the engine's range. x times
+	 * 2^23 is exact in double, so in range this rounds as before. */
+	static inline void load(Raw x, int32_t& v) {
+		double s = x * 8388608.0;
+		if (s > 2147483647.0) {
+			s = 2147483647.0;
+		}
+		if (s < -2147483648.0) {
+			s = -2147483648.0;
+		}
+		v = int32_t(lrint(s));
+	}
+	static inline Raw store(double v, int32_t) {
+		return Raw(v * (1.0 / PCM_FULL_SCALE));
+	}
+	static inline Raw store(int32_t v, int32_t) {
+		return Raw(v) * (1.0f / 8388608.0f);
+	}
+};
+
+template <typename F, typename Sample>
+CPU_INLINE void readPlanes(const void* data, int32_t channels, uint32_t first, int32_t frames, Sample* const* planes)
+{
+	const typename F::Raw* in = (const typename F::Raw*) data + first * channels;
+
+	/* Stereo is the common case; give it a loop of its own. */
+	if (channels == 2) {
+		Sample* left = planes[0];
+		Sample* right = planes[1];
+		for (int32_t i = 0; i < frames; i ++) {
+			F::load(in[2 * i], left[i]);
+			F::load(in[2 * i + 1], right[i]);
+		}
+		return;
+	}
+
+	for (int32_t c = 0; c < channels; c ++) {
+		Sample* plane = planes[c];
+		for (int32_t i = 0; i < frames; i ++) {
+			F::load(in[i * channels + c], plane[i]);
+		}
+	}
+}
+
+template <typename F, typename Sample>
+CPU_INLINE void writePlanes(void* data, int32_t channels, uint32_t first, int32_t frames, const Sample* const* planes, PcmDither* dither)
+{
+	typename F::Raw* out = (typename F::Raw*) data + first * channels;
+	bool dithered = F::DITHERED && dither != 0;
+
+	if (channels == 2) {
+		const Sample* left = planes[0];
+		const Sample* right = planes[1];
+		if (dithered) {
+			for (int32_t i = 0; i < frames; i ++) {
+				out[2 * i] = F::store(left[i], dither->next());
+				out[2 * i + 1] = F::store(right[i], dither->next());
+			}
+		} else {
+			for (int32_t i = 0; i < frames; i ++) {
+				out[2 * i] = F::store(left[i], 0);
+				out[2 * i + 1] = F::store(right[i], 0);
+			}
+		}
+		return;
+	}
+
+	for (int32_t c = 0; c < channels; c ++) {
+		const Sample* plane = planes[c];
+		for (int32_t i = 0; i < frames; i ++) {
+			out[i * channels + c] = F::store(plane[i], dithered ? dither->next() : 0);
+		}
+	}
+}
+
+template <typename Sample>
+CPU_INLINE void readAny(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, Sample* const* planes)
+{
+	switch (format) {
+	case AUDIO_FORMAT_PCM_16_BIT:
+		readPlanes<S16>(in->raw, channels, first, frames, planes);
+		break;
+	case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+		readPlanes<S24Packed>(in->raw, channels, first, frames, planes);
+		break;
+	case AUDIO_FORMAT_PCM_8_24_BIT:
+		readPlanes<S8_24>(in->raw, channels, first, frames, planes);
+		break;
+	case AUDIO_FORMAT_PCM_32_BIT:
+		readPlanes<S32>(in->raw, channels, first, frames, planes);
+		break;
+	case AUDIO_FORMAT_PCM_FLOAT:
+		readPlanes<Float>(in->raw, channels, first, frames, planes);
+		break;
+	default:
+		break;
+	}
+}
+
+template <typename Sample>
+CPU_INLINE void writeAny(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const Sample* const* planes, PcmDither* dither)
+{
+	switch (format) {
+	case AUDIO_FORMAT_PCM_16_BIT:
+		writePlanes<S16>(out->raw, channels, first, frames, planes, dither);
+		break;
+	case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+		writePlanes<S24Packed>(out->raw, channels, first, frames, planes, dither);
+		break;
+	case AUDIO_FORMAT_PCM_8_24_BIT:
+		writePlanes<S8_24>(out->raw, channels, first, frames, planes, dither);
+		break;
+	case AUDIO_FORMAT_PCM_32_BIT:
+		writePlanes<S32>(out->raw, channels, first, frames, planes, dither);
+		break;
+	case AUDIO_FORMAT_PCM_FLOAT:
+		writePlanes<Float>(out->raw, channels, first, frames, planes, dither);
+		break;
+	default:
+		break;
+	}
+}
+
+/* The drivers above, built once per instruction set level. */
+template <typename Sample>
+void readGeneric(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, Sample* const* planes)
+{
+	readAny(in, format, channels, first, frames, planes);
+}
+
+template <typename Sample>
+void writeGeneric(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const Sample* const* planes, PcmDither* dither)
+{
+	writeAny(out, format, channels, first, frames, planes, dither);
+}
+
+#ifdef CPU_X86
+template <typename Sample>
+CPU_AVX2 void readAvx2(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, Sample* const* planes)
+{
+	readAny(in, format, channels, first, frames, planes);
+}
+
+template <typename Sample>
+CPU_AVX2 void writeAvx2(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const Sample* const* planes, PcmDither* dither)
+{
+	writeAny(out, format, channels, first, frames, planes, dither);
+}
+
+template <typename Sample>
+CPU_AVX512 void readAvx512(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, Sample* const* planes)
+{
+	readAny(in, format, channels, first, frames, planes);
+}
+
+template <typename Sample>
+CPU_AVX512 void writeAvx512(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const Sample* const* planes, PcmDither* dither)
+{
+	writeAny(out, format, channels, first, frames, planes, dither);
+}
+#endif
+
+template <typename Sample>
+struct Kernel {
+	typedef void (*Read)(const audio_buffer_t*, audio_format_t, int32_t, uint32_t, int32_t, Sample* const*);
+	typedef void (*Write)(audio_buffer_t*, audio_format_t, int32_t, uint32_t, int32_t, const Sample* const*, PcmDither*);
+};
+
+}
+
+static const Kernel<double>::Read sRead = CPU_SELECT(readGeneric<double>, readAvx2<double>, readAvx512<double>);
+static const Kernel<double>::Write sWrite = CPU_SELECT(writeGeneric<double>, writeAvx2<double>, writeAvx512<double>);
+#ifdef DSP_FIXED_POINT
+static const Kernel<int32_t>::Read sReadFixed = CPU_SELECT(readGeneric<int32_t>, readAvx2<int32_t>, readAvx512<int32_t>);
+static const Kernel<int32_t>::Write sWriteFixed = CPU_SELECT(writeGeneric<int32_t>, writeAvx2<int32_t>, writeAvx512<int32_t>);
+#endif
+
+/* Seeds spread over the generator's period by the golden ratio */
+uint32_t PcmDither::nextSeed()
+{
+	static std::atomic<uint32_t> sCount(0);
+	return sCount.fetch_add(1, std::memory_order_relaxed) * 0x9e3779b9u;
+}
+
+bool pcmIsSupported(audio_format_t format)
+{
+	return format == AUDIO_FORMAT_PCM_16_BIT
+		|| format == AUDIO_FORMAT_PCM_24_BIT_PACKED
+		|| format == AUDIO_FORMAT_PCM_8_24_BIT
+		|| format == AUDIO_FORMAT_PCM_32_BIT
+		|| format == AUDIO_FORMAT_PCM_FLOAT;
+}
+
+void pcmRead(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, double* const* planes)
+{
+	sRead(in, format, channels, first, frames, planes);
+}
+
+void pcmWrite(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const double* const* planes, PcmDither* dither)
+{
+	sWrite(out, format, channels, first, frames, planes, dither);
+}
+
+#ifdef DSP_FIXED_POINT
+void pcmRead(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, int32_t* const* planes)
+{
+	sReadFixed(in, format, channels, first, frames, planes);
+}
+
+void pcmWrite(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const int32_t* const* planes, PcmDither* dither)
+{
+	sWriteFixed(out, format, channels, first, frames, planes, dither);
+}
+#endif
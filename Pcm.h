@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "system/audio.h"
+#include "hardware/audio_effect.h"
+
+#include "Fixed.h"
+
+/* Planar buffers hold samples with full scale at 2^23 regardless of the
+ * PCM format, so s16 has 8 bits of headroom below and 8.24 maps 1:1. */
+#define PCM_FULL_SCALE 8388608.0
+
+/* High-passed triangular probability density function.
+ * Output varies from -0xff to 0xff, +-1 LSB of s16 at planar scale.
+ *
+ * Each instance runs its own generator rather than rand(), whose state
+ * and lock every audio thread in the process would share. Instances
+ * start at different seeds, so sessions mixed downstream don't add up
+ * the same dither. */
+class PcmDither {
+	uint32_t mState;
+	uint8_t mPreviousRandom;
+
+	static uint32_t nextSeed();
+
+	public:
+	PcmDither()
+		: mState(nextSeed()), mPreviousRandom(0)
+	{
+	}
+
+	inline int32_t next() {
+		/* LCG of Numerical Recipes; the top byte has the full period. */
+		mState = mState * 1664525u + 1013904223u;
+		uint8_t newRandom = mState >> 24;
+		int32_t rnd = int32_t(mPreviousRandom) - int32_t(newRandom);
+		mPreviousRandom = newRandom;
+		return rnd;
+	}
+};
+
+/* s16, 24 bit packed, 8.24, s32 and float. */
+bool pcmIsSupported(audio_format_t format);
+
+/* Converts frames [first, first + frames) of an interleaved buffer with
+ * the given number of channels into planes[0 .. channels). */
+void pcmRead(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, double* const* planes);
+
+/* Interleaves planes back into out. Integer formats saturate; float keeps
+ * its headroom. s16 output is dithered when dither is given. */
+void pcmWrite(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const double* const* planes, PcmDither* dither);
+
+#ifdef DSP_FIXED_POINT
+void pcmRead(const audio_buffer_t* in, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, int32_t* const* planes);
+void pcmWrite(audio_buffer_t* out, audio_format_t format, int32_t channels, uint32_t first, int32_t frames, const int32_t* const* planes, PcmDither* dither);
+#endif
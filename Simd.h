@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Four float lanes. GCC and clang lower this to SSE on x86 and to NEON
+ * on ARM, so the kernels are written once for both. */
+typedef float v4sf __attribute__((vector_size(16)));
+
+/* Eight and sixteen float lanes, only inside kernels built for AVX2 and
+ * AVX-512, see Cpu.h. 16 byte alignment, like v4df. */
+typedef float v8sf __attribute__((vector_size(32), aligned(16)));
+typedef float v16sf __attribute__((vector_size(64), aligned(16)));
+
+/* Two double lanes, one register on SSE2 and AArch64 NEON. */
+typedef double v2df __attribute__((vector_size(16)));
+
+/* Four double lanes, two registers wide on SSE2 and NEON. Only 16 byte
+ * alignment is assumed so that members of this type are safe inside
+ * heap-allocated effect instances. */
+typedef double v4df __attribute__((vector_size(32), aligned(16)));
+
+/* Buffers handed to the SIMD kernels start on a cache line. */
+#define SIMD_ALIGNMENT 64
+
+template <typename T>
+inline T* alignedNew(int32_t count)
+{
+	void* p = 0;
+	if (posix_memalign(&p, SIMD_ALIGNMENT, count * sizeof(T)) != 0) {
+		return 0;
+	}
+	return (T*) p;
+}
+
+inline void alignedDelete(void* p)
+{
+	free(p);
+}
+
+inline v4sf loadV4(const float* p)
+{
+	return *(const v4sf*) p;
+}
+
+inline void storeV4(float* p, v4sf v)
+{
+	*(v4sf*) p = v;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SlidingMax.h"
+
+SlidingMax::SlidingMax()
+	: mValue(0), mTime(0), mCapacity(0), mWindow(1), mFront(0), mCount(0), mNow(0)
+{
+}
+
+SlidingMax::~SlidingMax()
+{
+	delete[] mValue;
+	delete[] mTime;
+}
+
+void SlidingMax::setWindow(int32_t window)
+{
+	if (window < 1) {
+		window = 1;
+	}
+	if (window > mCapacity) {
+		delete[] mValue;
+		delete[] mTime;
+		mValue = new double[window];
+		mTime = new uint32_t[window];
+		mCapacity = window;
+	}
+	mWindow = window;
+	reset();
+}
+
+void SlidingMax::reset()
+{
+	mFront = 0;
+	mCount = 0;
+	mNow = 0;
+}
+
+double SlidingMax::process(double x0)
+{
+	/* Drop candidates from the back that can never be the maximum again. */
+	while (mCount != 0) {
+		int32_t back = mFront + mCount - 1;
+		if (back >= mCapacity) {
+			back -= mCapacity;
+		}
+		if (mValue[back] > x0) {
+			break;
+		}
+		mCount --;
+	}
+
+	/* Expire the front, at most one per sample. */
+	if (mCount != 0 && mNow - mTime[mFront] >= uint32_t(mWindow)) {
+		mFront = mFront + 1 == mCapacity ? 0 : mFront + 1;
+		mCount --;
+	}
+
+	int32_t back = mFront + mCount;
+	if (back >= mCapacity) {
+		back -= mCapacity;
+	}
+	mValue[back] = x0;
+	mTime[back] = mNow;
+	mCount ++;
+	mNow ++;
+
+	return mValue[mFront];
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Maximum over the last window inputs, in amortized O(1) per sample.
+ * Keeps a monotonically decreasing deque of candidates: a new value
+ * evicts every older value it dominates, and the front expires once it
+ * leaves the window. */
+class SlidingMax {
+	double* mValue;
+	uint32_t* mTime;
+	int32_t mCapacity;
+	int32_t mWindow;
+	int32_t mFront;
+	int32_t mCount;
+	uint32_t mNow;
+
+	public:
+	SlidingMax();
+	~SlidingMax();
+	void setWindow(int32_t window);
+	double process(double x0);
+	void reset();
+};
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Cost of the compressor's band modes.
+ *
+ * Selects 1, 3 and 4 bands through COMPRESSION_PARAM_BANDS and times
+ * process() on ten seconds of stereo noise at 48 kHz in 256 frame
+ * buffers. Prints the best of several runs, the modes taking turns, as
+ * us of CPU per second of audio, and the 3 and 4 band cost relative to broadband, which should
+ * stay within 2x. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Bench.h"
+#include "EffectCompression.h"
+
+#define SECONDS 10
+#define RATE 48000
+#define FRAMES 256
+#define RUNS 6
+
+extern "C" audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+static effect_handle_t createCompression(int16_t bands, audio_format_t format)
+{
+	const effect_uuid_t* uuid = NULL;
+	for (int32_t e = 0; e < BENCH_EFFECTS; e ++) {
+		if (strcmp(benchEffects[e].name, "compression") == 0) {
+			uuid = &benchEffects[e].uuid;
+		}
+	}
+
+	effect_handle_t handle;
+	if (AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(uuid, 0, 0, &handle) != 0) {
+		fprintf(stderr, "create_effect failed\n");
+		exit(1);
+	}
+	benchInit(handle);
+	benchConfigure(handle, format, AUDIO_CHANNEL_OUT_STEREO);
+	if (benchSetParameter(handle, COMPRESSION_PARAM_BANDS, bands) != 0) {
+		fprintf(stderr, "COMPRESSION_PARAM_BANDS %d rejected\n", bands);
+		exit(1);
+	}
+	benchEnable(handle);
+	return handle;
+}
+
+/* us per second of audio for one pass over the input. */
+static double measure(effect_handle_t handle, int32_t frameSize, void* input, void* output)
+{
+	int64_t start = benchNow();
+	for (int32_t first = 0; first < SECONDS * RATE; first += FRAMES) {
+		audio_buffer_t in = { FRAMES, { (uint8_t*) input + first * frameSize } };
+		audio_buffer_t out = { FRAMES, { (uint8_t*) output + first * frameSize } };
+		(*handle)->process(handle, &in, &out);
+	}
+	return (benchNow() - start) / 1000.0 / SECONDS;
+}
+
+int main()
+{
+	int32_t samples = SECONDS * RATE * 2;
+	std::vector<int16_t> s16(samples), s16Out(samples);
+	std::vector<float> f32(samples), f32Out(samples);
+	uint32_t seed = 1;
+	for (int32_t i = 0; i < samples; i ++) {
+		double x = benchRandom(&seed) * 0.5;
+		s16[i] = int16_t(x * 32767.0);
+		f32[i] = float(x);
+	}
+
+	printf("compression at 48 kHz stereo, %d frames, us of CPU per second of audio\n\n", FRAMES);
+	printf("format    1 band   3 bands         4 bands\n");
+
+	static const int16_t bands[3] = { 1, 3, 4 };
+	for (int32_t f = 0; f < 2; f ++) {
+		audio_format_t format = f == 0 ? AUDIO_FORMAT_PCM_16_BIT : AUDIO_FORMAT_PCM_FLOAT;
+		void* input = f == 0 ? (void*) s16.data() : (void*) f32.data();
+		void* output = f == 0 ? (void*) s16Out.data() : (void*) f32Out.data();
+
+		/* The modes take turns, so that a slow spell of the machine does
+		 * not fall on one of them only. */
+		effect_handle_t handles[3];
+		double us[3];
+		for (int32_t b = 0; b < 3; b ++) {
+			handles[b] = createCompression(bands[b], format);
+		}
+		for (int32_t run = 0; run < RUNS; run ++) {
+			for (int32_t b = 0; b < 3; b ++) {
+				double t = measure(handles[b], f == 0 ? 4 : 8, input, output);
+				if (run == 0 || t < us[b]) {
+					us[b] = t;
+				}
+			}
+		}
+		for (int32_t b = 0; b < 3; b ++) {
+			AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(handles[b]);
+		}
+
+		printf("%-6s  %8.0f  %8.0f (%.2fx)  %6.0f (%.2fx)\n", f == 0 ? "s16" : "float",
+				us[0], us[1], us[1] / us[0], us[2], us[2] / us[0]);
+	}
+
+	return 0;
+}
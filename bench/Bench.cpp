@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Bench.h"
+
+const BenchEffect benchEffects[BENCH_EFFECTS] = {
+	{ "compression", { 0xc3b61114, 0xdef3, 0x5a85, 0xa39d, { 0x5c, 0xc4, 0x02, 0x0a, 0xb8, 0xaf } } },
+	{ "bassboost", { 0xeb888559, 0x23db, 0x515f, 0xbd90, { 0x53, 0x60, 0x56, 0x5b, 0x1a, 0x46 } } },
+	{ "equalizer", { 0x06cc8ec6, 0x15a0, 0x5b8c, 0x9460, { 0xe3, 0x79, 0xbb, 0xa6, 0xc0, 0x90 } } },
+	{ "virtualizer", { 0x38e9eea4, 0xb7c9, 0x5230, 0xbf5c, { 0x60, 0x20, 0x3b, 0xf6, 0x42, 0x3c } } },
+	{ "limiter", { 0x1daefbd4, 0xad02, 0x4713, 0xafde, { 0x73, 0x1f, 0x73, 0xdc, 0x2e, 0x8d } } },
+	{ "chain", { 0x02c4e040, 0xa89b, 0x4af8, 0x8aaa, { 0xfc, 0xe7, 0xf5, 0xb1, 0xf0, 0xa1 } } },
+};
+
+int64_t benchNow()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* Sorts values. fraction is 0.5 for the median, 0.99 for p99. */
+double benchPercentile(double* values, int32_t count, double fraction)
+{
+	if (count == 0) {
+		return 0.0;
+	}
+	std::sort(values, values + count);
+	int32_t i = int32_t(fraction * (count - 1) + 0.5);
+	return values[i];
+}
+
+/* Uniform in [-1, 1), the same sequence on every host. */
+double benchRandom(uint32_t* state)
+{
+	*state = *state * 1664525u + 1013904223u;
+	return int32_t(*state) / 2147483648.0;
+}
+
+int32_t benchInit(effect_handle_t handle)
+{
+	int32_t reply = -1;
+	uint32_t replySize = sizeof(reply);
+	(*handle)->command(handle, EFFECT_CMD_INIT, 0, NULL, &replySize, &reply);
+	return reply;
+}
+
+int32_t benchConfigure(effect_handle_t handle, audio_format_t format, uint32_t channels)
+{
+	effect_config_t config;
+	memset(&config, 0, sizeof(config));
+	config.inputCfg.samplingRate = 48000;
+	config.inputCfg.channels = channels;
+	config.inputCfg.format = format;
+	config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+	config.inputCfg.mask = EFFECT_CONFIG_ALL;
+	config.outputCfg = config.inputCfg;
+	config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+
+	int32_t reply = -1;
+	uint32_t replySize = sizeof(reply);
+	(*handle)->command(handle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config, &replySize, &reply);
+	return reply;
+}
+
+int32_t benchEnable(effect_handle_t handle)
+{
+	int32_t reply = -1;
+	uint32_t replySize = sizeof(reply);
+	(*handle)->command(handle, EFFECT_CMD_ENABLE, 0, NULL, &replySize, &reply);
+	return reply;
+}
+
+static int32_t setParameter(effect_handle_t handle, const int32_t* parameter, int32_t count, int16_t value)
+{
+	/* The value follows the parameter, which is whole int32s here. */
+	int32_t data[sizeof(effect_param_t) / sizeof(int32_t) + 3];
+	effect_param_t* p = (effect_param_t*) data;
+	p->status = 0;
+	p->psize = count * sizeof(int32_t);
+	p->vsize = sizeof(int16_t);
+	memcpy(p->data, parameter, p->psize);
+	memcpy(p->data + p->psize, &value, sizeof(value));
+
+	int32_t reply = -1;
+	uint32_t replySize = sizeof(reply);
+	(*handle)->command(handle, EFFECT_CMD_SET_PARAM, sizeof(effect_param_t) + p->psize + p->vsize, p, &replySize, &reply);
+	return reply;
+}
+
+int32_t benchSetParameter(effect_handle_t handle, int32_t parameter, int16_t value)
+{
+	return setParameter(handle, &parameter, 1, value);
+}
+
+int32_t benchSetParameter(effect_handle_t handle, int32_t parameter, int32_t argument, int16_t value)
+{
+	int32_t both[2] = { parameter, argument };
+	return setParameter(handle, both, 2, value);
+}
+
+static std::atomic<uint64_t> sAllocations(0);
+
+uint64_t benchAllocations()
+{
+	return sAllocations.load();
+}
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+int __real_posix_memalign(void** p, size_t alignment, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+	sAllocations ++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	sAllocations ++;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* p, size_t size)
+{
+	sAllocations ++;
+	return __real_realloc(p, size);
+}
+
+int __wrap_posix_memalign(void** p, size_t alignment, size_t size)
+{
+	sAllocations ++;
+	return __real_posix_memalign(p, alignment, size);
+}
+
+}
+
+/* Replaces the C++ runtime's, so that its allocations go through the
+ * wrapped malloc() too. */
+void* operator new(size_t size)
+{
+	void* p = malloc(size);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return malloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+/* Off Android, the two functions the library takes from libutils. */
+namespace android {
+
+void sp_report_race()
+{
+	abort();
+}
+
+}
+
+extern "C" int64_t systemTime(int)
+{
+	return benchNow();
+}
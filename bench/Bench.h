@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "hardware/audio_effect.h"
+
+/* Helpers shared by the benchmarks in this directory, see Makefile. */
+
+struct BenchEffect {
+	const char* name;
+	effect_uuid_t uuid;
+};
+
+/* Every effect of the library, chain last. */
+#define BENCH_EFFECTS 6
+extern const BenchEffect benchEffects[BENCH_EFFECTS];
+
+/* Monotonic clock, ns. */
+int64_t benchNow();
+
+double benchPercentile(double* values, int32_t count, double fraction);
+
+double benchRandom(uint32_t* state);
+
+/* EFFECT_CMD_INIT, then EFFECT_CMD_SET_CONFIG for 48 kHz, the same
+ * format and channels in and out. Returns the reply. */
+int32_t benchInit(effect_handle_t handle);
+int32_t benchConfigure(effect_handle_t handle, audio_format_t format, uint32_t channels);
+int32_t benchEnable(effect_handle_t handle);
+
+/* EFFECT_CMD_SET_PARAM of one int16 value, for a parameter that is one
+ * int32, or an int32 and an argument such as a band index. Returns the
+ * reply. */
+int32_t benchSetParameter(effect_handle_t handle, int32_t parameter, int16_t value);
+int32_t benchSetParameter(effect_handle_t handle, int32_t parameter, int32_t argument, int16_t value);
+
+/* Heap allocations so far by anything in the process: operator new,
+ * malloc(), calloc(), realloc() and posix_memalign(). The C functions
+ * are counted through the linker's --wrap, see Makefile. */
+uint64_t benchAllocations();
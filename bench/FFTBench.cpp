@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Accuracy and speed of FFT against a naive DFT.
+ *
+ * For each size from 64 to 16384, transforms one block of uniform
+ * random input in [-1, 1) and compares every bin with a DFT evaluated
+ * directly in double precision. Prints the largest error of a bin, that
+ * error relative to the RMS bin magnitude, and the largest error after
+ * a round trip through inverse(). Times are the best of several runs:
+ * one forward plus one inverse transform, and one direct DFT of all
+ * N / 2 + 1 bins from a table of twiddles.
+ *
+ * FFT has one v4sf code path, so DSP_ISA does not change these figures;
+ * the build's compiler flags do. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "Bench.h"
+#include "FFT.h"
+#include "Simd.h"
+
+#define RUNS 5
+
+/* re[0 .. N/2] and im[0 .. N/2] of x, directly. */
+static void naiveDft(const float* x, int32_t n, const double* cosine, const double* sine, double* re, double* im)
+{
+	for (int32_t k = 0; k <= n / 2; k ++) {
+		double sumRe = 0.0, sumIm = 0.0;
+		int32_t index = 0;
+		for (int32_t i = 0; i < n; i ++) {
+			sumRe += x[i] * cosine[index];
+			sumIm -= x[i] * sine[index];
+			index = (index + k) & (n - 1);
+		}
+		re[k] = sumRe;
+		im[k] = sumIm;
+	}
+}
+
+int main()
+{
+	printf("FFT against a naive DFT, random input in [-1, 1)\n\n");
+	printf("    N  forward+inverse    naive DFT  speedup   max error  rel. error  round trip\n");
+
+	for (int32_t n = 64; n <= 16384; n *= 2) {
+		float* x = alignedNew<float>(n);
+		float* re = alignedNew<float>(n / 2);
+		float* im = alignedNew<float>(n / 2);
+		float* y = alignedNew<float>(n);
+		double* cosine = new double[n];
+		double* sine = new double[n];
+		double* dftRe = new double[n / 2 + 1];
+		double* dftIm = new double[n / 2 + 1];
+
+		uint32_t seed = 1;
+		for (int32_t i = 0; i < n; i ++) {
+			x[i] = float(benchRandom(&seed));
+			cosine[i] = cos(2.0 * M_PI * i / n);
+			sine[i] = sin(2.0 * M_PI * i / n);
+		}
+
+		FFT fft;
+		fft.setSize(n);
+
+		/* Accuracy. Bin 0 packs DC in re[0] and Nyquist in im[0]. */
+		naiveDft(x, n, cosine, sine, dftRe, dftIm);
+		fft.forward(x, re, im);
+		double maximum = 0.0, power = 0.0;
+		for (int32_t k = 0; k <= n / 2; k ++) {
+			double binRe = k == 0 ? re[0] : k == n / 2 ? im[0] : re[k];
+			double binIm = k == 0 || k == n / 2 ? 0.0 : im[k];
+			double error = hypot(binRe - dftRe[k], binIm - dftIm[k]);
+			if (error > maximum) {
+				maximum = error;
+			}
+			power += dftRe[k] * dftRe[k] + dftIm[k] * dftIm[k];
+		}
+		double rms = sqrt(power / (n / 2 + 1));
+
+		fft.inverse(re, im, y);
+		double roundTrip = 0.0;
+		for (int32_t i = 0; i < n; i ++) {
+			double error = fabs(y[i] - x[i]);
+			if (error > roundTrip) {
+				roundTrip = error;
+			}
+		}
+
+		/* Speed, about 20 ms of transforms per run. */
+		int32_t loops = 4000000 / n + 1;
+		double fastest = 1e30;
+		for (int32_t run = 0; run < RUNS; run ++) {
+			int64_t start = benchNow();
+			for (int32_t i = 0; i < loops; i ++) {
+				fft.forward(x, re, im);
+				fft.inverse(re, im, y);
+			}
+			double ns = double(benchNow() - start) / loops;
+			if (ns < fastest) {
+				fastest = ns;
+			}
+		}
+
+		double naive = 1e30;
+		for (int32_t run = 0; run < (n <= 2048 ? RUNS : 1); run ++) {
+			int64_t start = benchNow();
+			naiveDft(x, n, cosine, sine, dftRe, dftIm);
+			double ns = double(benchNow() - start);
+			if (ns < naive) {
+				naive = ns;
+			}
+		}
+
+		printf("%5d  %12.2f us  %8.0f us  %7.0fx  %10.2e  %10.2e  %10.2e\n",
+				n, fastest / 1000.0, naive / 1000.0, naive / fastest, maximum, maximum / rms, roundTrip);
+
+		alignedDelete(x);
+		alignedDelete(re);
+		alignedDelete(im);
+		alignedDelete(y);
+		delete[] cosine;
+		delete[] sine;
+		delete[] dftRe;
+		delete[] dftIm;
+	}
+
+	return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Noise floor of the integer engine against the double one.
+ *
+ * Loads the library twice, built as it ships and with DSP_FIXED_POINT
+ * (see Makefile), the way the effect factory loads effect libraries.
+ * The equalizer with uneven bands and the compressor at ratio 6 each
+ * process the same stereo input through both builds, in s16, s32 and
+ * float. Prints the RMS of the difference of the outputs, dBFS, after
+ * the first second, once the gain and level detectors have settled.
+ *
+ * The input is two tones and white noise, about -12 dBFS RMS. Dithered
+ * s16 output may differ by the 1 LSB the dither rounds to. */
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "system/audio_effects/effect_equalizer.h"
+
+#define SECONDS 4
+#define SETTLE_SECONDS 1
+#define RATE 48000
+#define FRAMES 256
+
+static audio_effect_library_t* loadLibrary(const std::string& directory, const char* file)
+{
+	std::string path = directory + file;
+	void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (library == NULL) {
+		fprintf(stderr, "%s\n", dlerror());
+		exit(1);
+	}
+	audio_effect_library_t* info = (audio_effect_library_t*) dlsym(library, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+	if (info == NULL) {
+		fprintf(stderr, "%s\n", dlerror());
+		exit(1);
+	}
+	return info;
+}
+
+static const effect_uuid_t* findEffect(const char* name)
+{
+	for (int32_t e = 0; e < BENCH_EFFECTS; e ++) {
+		if (strcmp(benchEffects[e].name, name) == 0) {
+			return &benchEffects[e].uuid;
+		}
+	}
+	return NULL;
+}
+
+static int32_t sampleSize(audio_format_t format)
+{
+	return format == AUDIO_FORMAT_PCM_16_BIT ? 2 : 4;
+}
+
+static void encode(const std::vector<double>& x, audio_format_t format, std::vector<uint8_t>& out)
+{
+	out.resize(x.size() * sampleSize(format));
+	for (size_t i = 0; i < x.size(); i ++) {
+		if (format == AUDIO_FORMAT_PCM_16_BIT) {
+			((int16_t*) out.data())[i] = int16_t(lrint(x[i] * 32767.0));
+		} else if (format == AUDIO_FORMAT_PCM_32_BIT) {
+			((int32_t*) out.data())[i] = int32_t(lrint(x[i] * 2147483647.0));
+		} else {
+			((float*) out.data())[i] = float(x[i]);
+		}
+	}
+}
+
+static double decode(const uint8_t* data, audio_format_t format, size_t i)
+{
+	if (format == AUDIO_FORMAT_PCM_16_BIT) {
+		return ((const int16_t*) data)[i] / 32768.0;
+	}
+	if (format == AUDIO_FORMAT_PCM_32_BIT) {
+		return ((const int32_t*) data)[i] / 2147483648.0;
+	}
+	return ((const float*) data)[i];
+}
+
+/* Runs the whole input through a new instance; returns the output at
+ * full scale 1. */
+static std::vector<double> render(audio_effect_library_t* library, const char* name, audio_format_t format, const std::vector<uint8_t>& input)
+{
+	effect_handle_t handle;
+	if (library->create_effect(findEffect(name), 0, 0, &handle) != 0) {
+		fprintf(stderr, "create_effect failed\n");
+		exit(1);
+	}
+	benchInit(handle);
+	if (benchConfigure(handle, format, AUDIO_CHANNEL_OUT_STEREO) != 0) {
+		fprintf(stderr, "EFFECT_CMD_SET_CONFIG failed\n");
+		exit(1);
+	}
+
+	if (strcmp(name, "equalizer") == 0) {
+		static const int16_t bands[6] = { 600, -300, 0, 400, -600, 800 };
+		for (int32_t b = 0; b < 6; b ++) {
+			benchSetParameter(handle, EQ_PARAM_BAND_LEVEL, b, bands[b]);
+		}
+	} else {
+		/* Ratio 1 + value / 100 */
+		benchSetParameter(handle, 0, int16_t(500));
+	}
+	benchEnable(handle);
+
+	int32_t frameSize = 2 * sampleSize(format);
+	int32_t frames = int32_t(input.size() / frameSize);
+	std::vector<uint8_t> in(input), out(input.size());
+	for (int32_t start = 0; start < frames; start += FRAMES) {
+		audio_buffer_t inBuffer = { FRAMES, { in.data() + start * frameSize } };
+		audio_buffer_t outBuffer = { FRAMES, { out.data() + start * frameSize } };
+		(*handle)->process(handle, &inBuffer, &outBuffer);
+	}
+	library->release_effect(handle);
+
+	std::vector<double> y(frames * 2);
+	for (size_t i = 0; i < y.size(); i ++) {
+		y[i] = decode(out.data(), format, i);
+	}
+	return y;
+}
+
+static double errorDb(const std::vector<double>& a, const std::vector<double>& b)
+{
+	double sum = 0.0;
+	size_t first = SETTLE_SECONDS * RATE * 2;
+	for (size_t i = first; i < a.size(); i ++) {
+		double d = a[i] - b[i];
+		sum += d * d;
+	}
+	double rms = sqrt(sum / (a.size() - first));
+	return rms > 0.0 ? 20.0 * log10(rms) : -INFINITY;
+}
+
+int main(int, char** argv)
+{
+	std::string directory(argv[0]);
+	directory.erase(directory.find_last_of('/') + 1);
+	audio_effect_library_t* doubleLibrary = loadLibrary(directory, "libdsp-double.so");
+	audio_effect_library_t* fixedLibrary = loadLibrary(directory, "libdsp-fixed.so");
+
+	std::vector<double> x(SECONDS * RATE * 2);
+	uint32_t seed = 1;
+	for (size_t i = 0; i < x.size() / 2; i ++) {
+		double t = double(i) / RATE;
+		for (int32_t c = 0; c < 2; c ++) {
+			x[2 * i + c] = 0.2 * sin(2.0 * M_PI * (c == 0 ? 100.0 : 150.0) * t)
+				+ 0.1 * sin(2.0 * M_PI * (c == 0 ? 1000.0 : 3000.0) * t)
+				+ 0.1 * benchRandom(&seed);
+		}
+	}
+
+	static const struct {
+		const char* name;
+		audio_format_t format;
+	} formats[] = {
+		{ "s16", AUDIO_FORMAT_PCM_16_BIT },
+		{ "s32", AUDIO_FORMAT_PCM_32_BIT },
+		{ "float", AUDIO_FORMAT_PCM_FLOAT },
+	};
+
+	printf("DSP_FIXED_POINT against double, stereo 48 kHz, RMS error in dBFS\n\n");
+	printf("format  equalizer  compression\n");
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f ++) {
+		std::vector<uint8_t> input;
+		encode(x, formats[f].format, input);
+		printf("%-6s", formats[f].name);
+		const char* effects[] = { "equalizer", "compression" };
+		for (int32_t e = 0; e < 2; e ++) {
+			std::vector<double> a = render(doubleLibrary, effects[e], formats[f].format, input);
+			std::vector<double> b = render(fixedLibrary, effects[e], formats[f].format, input);
+			printf(e == 0 ? "  %9.1f" : "  %11.1f", errorDb(a, b));
+		}
+		printf("\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Many sessions on many threads at once.
+ *
+ * N threads each drive M effect instances, every effect of the library
+ * in turn, with s16 stereo at 48 kHz in 256 frame buffers; a buffer is
+ * one process() call on each of the thread's instances. For each N the
+ * benchmark runs twice: as fast as it goes, for the buffers per second
+ * of all threads together, and at the real cadence of one buffer every
+ * 5.3 ms, for the p50 and p99 time a thread spends on one buffer. It
+ * also counts heap allocations while the threads process.
+ *
+ * The comparison afterwards times, on N threads at once, the shared
+ * state an audio library can trip over:
+ *	- rand(), which the s16 dither used to call per sample, against
+ *	  PcmDither::next(), each thread with its own generator;
+ *	- malloc() and free() of one buffer, against none, which is what
+ *	  process() does;
+ *	- an atomic counter per thread, like those of EffectStats, all on
+ *	  one cache line, against each on a line of its own, as EffectPool
+ *	  places instances.
+ * Figures are millions of operations per second of all threads
+ * together; if nothing is shared, they grow with N up to the number of
+ * cores.
+ *
+ *	scaling-bench [instances per thread] [seconds per run] */
+
+#include <atomic>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "Bench.h"
+#include "EffectPool.h"
+#include "Pcm.h"
+
+#define FRAMES 256
+#define MAX_THREADS 8
+#define COMPARE_ITERATIONS 2000000
+#define COMPARE_RUNS 3
+
+extern "C" audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+struct Session {
+	int32_t thread;
+	int32_t instances;
+	bool paced;
+	double seconds;
+	pthread_barrier_t* barrier;
+	/* Instances not on a cache line of their own */
+	int32_t misaligned;
+	int64_t buffers;
+	std::vector<double> latencies;
+};
+
+static void* runSession(void* arg)
+{
+	Session* session = (Session*) arg;
+
+	std::vector<effect_handle_t> handles(session->instances);
+	for (int32_t i = 0; i < session->instances; i ++) {
+		const BenchEffect* effect = &benchEffects[(session->thread * session->instances + i) % BENCH_EFFECTS];
+		if (AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(&effect->uuid, 0, 0, &handles[i]) != 0) {
+			fprintf(stderr, "create_effect failed\n");
+			exit(1);
+		}
+		benchInit(handles[i]);
+		benchConfigure(handles[i], AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO);
+		benchEnable(handles[i]);
+		if ((uintptr_t) handles[i] % EFFECT_POOL_ALIGNMENT != 0) {
+			session->misaligned ++;
+		}
+	}
+
+	std::vector<int16_t> input(FRAMES * 2), output(FRAMES * 2);
+	uint32_t seed = session->thread + 1;
+	for (size_t i = 0; i < input.size(); i ++) {
+		input[i] = int16_t(benchRandom(&seed) * 8192.0);
+	}
+	if (session->paced) {
+		session->latencies.reserve(int32_t(session->seconds * 48000 / FRAMES) + 16);
+	}
+
+	pthread_barrier_wait(session->barrier);
+
+	int64_t period = int64_t(FRAMES) * 1000000000LL / 48000;
+	int64_t start = benchNow();
+	int64_t end = start + int64_t(session->seconds * 1e9);
+	int64_t next = start;
+	int64_t now = start;
+	while (now < end) {
+		for (int32_t i = 0; i < session->instances; i ++) {
+			audio_buffer_t in = { FRAMES, { input.data() } };
+			audio_buffer_t out = { FRAMES, { output.data() } };
+			(*handles[i])->process(handles[i], &in, &out);
+		}
+		int64_t done = benchNow();
+		session->buffers ++;
+
+		/* Into the space reserved, the heap is counted meanwhile */
+		if (session->paced) {
+			session->latencies.push_back((done - now) / 1000.0);
+			next += period;
+			int64_t wait = next - done;
+			if (wait > 0) {
+				timespec ts = { 0, long(wait) };
+				nanosleep(&ts, NULL);
+			}
+		}
+		now = benchNow();
+	}
+
+	pthread_barrier_wait(session->barrier);
+
+	for (int32_t i = 0; i < session->instances; i ++) {
+		AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(handles[i]);
+	}
+	return NULL;
+}
+
+struct Run {
+	double buffersPerSecond;
+	double p50;
+	double p99;
+	uint64_t allocations;
+	int32_t misaligned;
+};
+
+static Run runSessions(int32_t threads, int32_t instances, bool paced, double seconds)
+{
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, threads + 1);
+
+	std::vector<Session> sessions(threads);
+	std::vector<pthread_t> ids(threads);
+	for (int32_t t = 0; t < threads; t ++) {
+		Session* session = &sessions[t];
+		session->thread = t;
+		session->instances = instances;
+		session->paced = paced;
+		session->seconds = seconds;
+		session->barrier = &barrier;
+		session->misaligned = 0;
+		session->buffers = 0;
+		pthread_create(&ids[t], NULL, runSession, session);
+	}
+
+	/* Between the barriers every thread is in its process() loop. */
+	pthread_barrier_wait(&barrier);
+	uint64_t allocations = benchAllocations();
+	pthread_barrier_wait(&barrier);
+	Run run;
+	run.allocations = benchAllocations() - allocations;
+
+	std::vector<double> latencies;
+	int64_t buffers = 0;
+	run.misaligned = 0;
+	for (int32_t t = 0; t < threads; t ++) {
+		pthread_join(ids[t], NULL);
+		latencies.insert(latencies.end(), sessions[t].latencies.begin(), sessions[t].latencies.end());
+		buffers += sessions[t].buffers;
+		run.misaligned += sessions[t].misaligned;
+	}
+	pthread_barrier_destroy(&barrier);
+
+	run.buffersPerSecond = buffers / seconds;
+	run.p50 = paced ? benchPercentile(latencies.data(), int32_t(latencies.size()), 0.5) : 0;
+	run.p99 = paced ? benchPercentile(latencies.data(), int32_t(latencies.size()), 0.99) : 0;
+	return run;
+}
+
+/* The comparison: the same loop body on every thread. */
+
+struct Counter {
+	alignas(64) std::atomic<int64_t> value;
+};
+
+struct Job {
+	int32_t thread;
+	pthread_barrier_t* barrier;
+	void* (*body)(Job*);
+	/* One line for every thread, or a line of its own */
+	std::atomic<int64_t>* counter;
+	int32_t sink;
+	int64_t start;
+	int64_t end;
+};
+
+static void* ditherRand(Job* job)
+{
+	uint8_t previous = 0;
+	int32_t sum = 0;
+	for (int32_t i = 0; i < COMPARE_ITERATIONS; i ++) {
+		uint8_t random = rand() & 0xff;
+		sum += int32_t(previous) - int32_t(random);
+		previous = random;
+	}
+	job->sink = sum;
+	return NULL;
+}
+
+static void* ditherOwn(Job* job)
+{
+	PcmDither dither;
+	int32_t sum = 0;
+	for (int32_t i = 0; i < COMPARE_ITERATIONS; i ++) {
+		sum += dither.next();
+	}
+	job->sink = sum;
+	return NULL;
+}
+
+static void* allocate(Job* job)
+{
+	for (int32_t i = 0; i < COMPARE_ITERATIONS / 16; i ++) {
+		double* buffer = (double*) malloc(FRAMES * 2 * sizeof(double));
+		buffer[i % (FRAMES * 2)] = i;
+		job->sink += int32_t(buffer[0]);
+		free(buffer);
+	}
+	return NULL;
+}
+
+static void* count(Job* job)
+{
+	for (int32_t i = 0; i < COMPARE_ITERATIONS; i ++) {
+		job->counter->fetch_add(1, std::memory_order_relaxed);
+	}
+	return NULL;
+}
+
+static void* runJob(void* arg)
+{
+	Job* job = (Job*) arg;
+	pthread_barrier_wait(job->barrier);
+	job->start = benchNow();
+	job->body(job);
+	job->end = benchNow();
+	return NULL;
+}
+
+static double compareOnce(int32_t threads, void* (*body)(Job*), int32_t iterations, bool sharedLine)
+{
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, threads + 1);
+
+	Counter counters[MAX_THREADS];
+	alignas(64) std::atomic<int64_t> shared[MAX_THREADS];
+	std::vector<Job> jobs(threads);
+	std::vector<pthread_t> ids(threads);
+	for (int32_t t = 0; t < threads; t ++) {
+		counters[t].value = 0;
+		shared[t] = 0;
+		jobs[t].thread = t;
+		jobs[t].barrier = &barrier;
+		jobs[t].body = body;
+		jobs[t].counter = sharedLine ? &shared[t] : &counters[t].value;
+		jobs[t].sink = 0;
+		pthread_create(&ids[t], NULL, runJob, &jobs[t]);
+	}
+
+	/* From the first thread to start to the last to finish */
+	pthread_barrier_wait(&barrier);
+	int64_t start = INT64_MAX;
+	int64_t end = INT64_MIN;
+	for (int32_t t = 0; t < threads; t ++) {
+		pthread_join(ids[t], NULL);
+		start = jobs[t].start < start ? jobs[t].start : start;
+		end = jobs[t].end > end ? jobs[t].end : end;
+	}
+	pthread_barrier_destroy(&barrier);
+	return double(iterations) * threads / ((end - start) / 1000.0);
+}
+
+/* Millions of iterations per second of all threads together, the
+ * median of a few runs. */
+static double compare(int32_t threads, void* (*body)(Job*), int32_t iterations, bool sharedLine)
+{
+	double runs[COMPARE_RUNS];
+	for (int32_t i = 0; i < COMPARE_RUNS; i ++) {
+		runs[i] = compareOnce(threads, body, iterations, sharedLine);
+	}
+	return benchPercentile(runs, COMPARE_RUNS, 0.5);
+}
+
+int main(int argc, char** argv)
+{
+	int32_t instances = argc > 1 ? atoi(argv[1]) : 2;
+	double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+	if (instances < 1 || seconds <= 0) {
+		fprintf(stderr, "usage: %s [instances per thread] [seconds per run]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%d instances per thread, s16 stereo 48 kHz, %d frames per buffer\n\n", instances, FRAMES);
+	printf("threads   buffers/s  x realtime/thread    paced p50 us  p99 us   allocs  misaligned\n");
+	for (int32_t threads = 1; threads <= MAX_THREADS; threads *= 2) {
+		Run fast = runSessions(threads, instances, false, seconds);
+		Run paced = runSessions(threads, instances, true, seconds);
+		printf("%7d  %10.0f  %17.1f    %12.1f  %6.1f   %6llu  %10d\n",
+				threads, fast.buffersPerSecond, fast.buffersPerSecond * FRAMES / 48000.0 / threads,
+				paced.p50, paced.p99,
+				(unsigned long long) (fast.allocations + paced.allocations),
+				fast.misaligned + paced.misaligned);
+	}
+
+	printf("\nshared state, million iterations/s of all threads\n");
+	printf("threads     rand()  PcmDither   malloc+free  counters: one line  own lines\n");
+	for (int32_t threads = 1; threads <= MAX_THREADS; threads *= 2) {
+		printf("%7d  %9.1f  %9.1f   %11.1f  %18.1f  %9.1f\n", threads,
+				compare(threads, ditherRand, COMPARE_ITERATIONS, false),
+				compare(threads, ditherOwn, COMPARE_ITERATIONS, false),
+				compare(threads, allocate, COMPARE_ITERATIONS / 16, false),
+				compare(threads, count, COMPARE_ITERATIONS, true),
+				compare(threads, count, COMPARE_ITERATIONS, false));
+	}
+
+	return 0;
+}
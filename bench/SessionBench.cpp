@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Cost of starting a session: create, configure and the first process()
+ * call, the way AudioFlinger starts an effect.
+ *
+ * Each cycle runs create_effect() and EFFECT_CMD_INIT, then
+ * EFFECT_CMD_SET_CONFIG (48 kHz stereo float) and EFFECT_CMD_ENABLE,
+ * then processes one 256 frame buffer, and releases the effect. The
+ * first cycle of each effect finds its pool empty and is reported on its
+ * own; the others take over the instance the previous cycle released.
+ * Prints the median time of each stage, the median, p99 and largest
+ * total, and heap allocations per cycle, release included. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Bench.h"
+
+#define CYCLES 2000
+#define FRAMES 256
+
+extern "C" audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+struct Cycle {
+	double create;
+	double configure;
+	double process;
+	uint64_t allocations;
+};
+
+static Cycle runCycle(const effect_uuid_t* uuid, float* buffer)
+{
+	Cycle cycle;
+	uint64_t allocations = benchAllocations();
+
+	int64_t start = benchNow();
+	effect_handle_t handle;
+	if (AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(uuid, 0, 0, &handle) != 0) {
+		fprintf(stderr, "create_effect failed\n");
+		exit(1);
+	}
+	benchInit(handle);
+	int64_t created = benchNow();
+
+	if (benchConfigure(handle, AUDIO_FORMAT_PCM_FLOAT, AUDIO_CHANNEL_OUT_STEREO) != 0) {
+		fprintf(stderr, "EFFECT_CMD_SET_CONFIG failed\n");
+		exit(1);
+	}
+	benchEnable(handle);
+	int64_t configured = benchNow();
+
+	audio_buffer_t in = { FRAMES, { buffer } };
+	audio_buffer_t out = { FRAMES, { buffer } };
+	(*handle)->process(handle, &in, &out);
+	int64_t processed = benchNow();
+
+	AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(handle);
+
+	cycle.create = (created - start) / 1000.0;
+	cycle.configure = (configured - created) / 1000.0;
+	cycle.process = (processed - configured) / 1000.0;
+	cycle.allocations = benchAllocations() - allocations;
+	return cycle;
+}
+
+int main()
+{
+	std::vector<float> buffer(FRAMES * 2);
+	uint32_t seed = 1;
+	for (size_t i = 0; i < buffer.size(); i ++) {
+		buffer[i] = float(benchRandom(&seed) * 0.5);
+	}
+
+	std::vector<double> create(CYCLES), configure(CYCLES), process(CYCLES), total(CYCLES);
+
+	printf("create -> configure -> first process(), 48 kHz stereo float, %d frames, us\n\n", FRAMES);
+	printf("              first cycle         median of %d cycles                                allocs\n", CYCLES);
+	printf("effect        total  allocs    create  configure  process    total    p99      max   /cycle\n");
+
+	for (int32_t e = 0; e < BENCH_EFFECTS; e ++) {
+		const effect_uuid_t* uuid = &benchEffects[e].uuid;
+		Cycle first = runCycle(uuid, buffer.data());
+
+		uint64_t allocations = 0;
+		for (int32_t i = 0; i < CYCLES; i ++) {
+			Cycle cycle = runCycle(uuid, buffer.data());
+			create[i] = cycle.create;
+			configure[i] = cycle.configure;
+			process[i] = cycle.process;
+			total[i] = cycle.create + cycle.configure + cycle.process;
+			allocations += cycle.allocations;
+		}
+
+		double medianTotal = benchPercentile(total.data(), CYCLES, 0.5);
+		double p99 = benchPercentile(total.data(), CYCLES, 0.99);
+		double maximum = benchPercentile(total.data(), CYCLES, 1.0);
+		printf("%-12s %6.1f  %6llu    %6.1f  %9.1f  %7.1f  %7.1f %6.1f %8.1f  %7.2f\n",
+				benchEffects[e].name,
+				first.create + first.configure + first.process, (unsigned long long) first.allocations,
+				benchPercentile(create.data(), CYCLES, 0.5),
+				benchPercentile(configure.data(), CYCLES, 0.5),
+				benchPercentile(process.data(), CYCLES, 0.5),
+				medianTotal, p99, maximum, double(allocations) / CYCLES);
+	}
+
+	return 0;
+}
@@ -29,11 +29,14 @@
 
 #include "Effect.h"
 #include "EffectBassBoost.h"
+#include "EffectChain.h"
 #include "EffectCompression.h"
 #include "EffectEqualizer.h"
+#include "EffectLimiter.h"
+#include "EffectPool.h"
 #include "EffectVirtualizer.h"
 
-static effect_descriptor_t compression_descriptor = {
+static constexpr effect_descriptor_t compression_descriptor = {
 	{ 0x09e8ede0, 0xddde, 0x11db, 0xb4f6, { 0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b } }, // SL_IID_VOLUME
 	{ 0xc3b61114, 0xdef3, 0x5a85, 0xa39d, { 0x5c, 0xc4, 0x02, 0x0a, 0xb8, 0xaf } }, // own UUID
 	EFFECT_CONTROL_API_VERSION,
@@ -44,7 +47,7 @@ static effect_descriptor_t compression_descriptor = {
 	"Antti S. Lankila"
 };
 
-static effect_descriptor_t bassboost_descriptor = {
+static constexpr effect_descriptor_t bassboost_descriptor = {
 	{ 0x3345d821, 0xbf49, 0x50d1, 0x84db, { 0x5f, 0x7a, 0x49, 0x90, 0xc0, 0x1b } }, // SL_IID_VOLUME
 	{ 0xeb888559, 0x23db, 0x515f, 0xbd90, { 0x53, 0x60, 0x56, 0x5b, 0x1a, 0x46 } }, // own UUID
 	EFFECT_CONTROL_API_VERSION,
@@ -55,7 +58,7 @@ static effect_descriptor_t bassboost_descriptor = {
 	"Antti S. Lankila"
 };
 
-static effect_descriptor_t equalizer_descriptor = {
+static constexpr effect_descriptor_t equalizer_descriptor = {
 	{ 0xa9d9ecab, 0x1521, 0x506a, 0xa6aa, { 0xc8, 0xab, 0xba, 0xf2, 0xca, 0x26 } }, // SL_IID_VOLUME
         { 0x06cc8ec6, 0x15a0, 0x5b8c, 0x9460, { 0xe3, 0x79, 0xbb, 0xa6, 0xc0, 0x90 } }, // own UUID
 	EFFECT_CONTROL_API_VERSION,
@@ -66,7 +69,7 @@ static effect_descriptor_t equalizer_descriptor = {
 	"Antti S. Lankila"
 };
 
-static effect_descriptor_t virtualizer_descriptor = {
+static constexpr effect_descriptor_t virtualizer_descriptor = {
 	{ 0x27cf8d17, 0x2060, 0x5ebc, 0x9ac8, { 0x19, 0x0c, 0x7f, 0x5e, 0xbc, 0x15 } }, // SL_IID_VOLUME
 	{ 0x38e9eea4, 0xb7c9, 0x5230, 0xbf5c, { 0x60, 0x20, 0x3b, 0xf6, 0x42, 0x3c } }, // own UUID
 	EFFECT_CONTROL_API_VERSION,
@@ -77,23 +80,44 @@ static effect_descriptor_t virtualizer_descriptor = {
 	"Antti S. Lankila"
 };
 
-/* Library mandatory methods. */
-extern "C" {
+static constexpr effect_descriptor_t limiter_descriptor = {
+	{ 0x15991b74, 0xe51b, 0x4b58, 0xa3f3, { 0x5b, 0x1f, 0x58, 0xb9, 0xf0, 0x0e } },
+	{ 0x1daefbd4, 0xad02, 0x4713, 0xafde, { 0x73, 0x1f, 0x73, 0xdc, 0x2e, 0x8d } }, // own UUID
+	EFFECT_CONTROL_API_VERSION,
+	EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_LAST,
+	20, /* 2 MIPS. FIXME: should be measured. */
+	2,
+	"CyanogenMod's Lookahead Limiter",
+	"Antti S. Lankila"
+};
+
+static constexpr effect_descriptor_t chain_descriptor = {
+	{ 0x44e9c654, 0xc3c7, 0x4947, 0x909f, { 0xa9, 0x5b, 0x0f, 0xd7, 0x54, 0x4e } },
+	{ 0x02c4e040, 0xa89b, 0x4af8, 0x8aaa, { 0xfc, 0xe7, 0xf5, 0xb1, 0xf0, 0xa1 } }, // own UUID
+	EFFECT_CONTROL_API_VERSION,
+	EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_FIRST,
+	60, /* 6 MIPS. FIXME: should be measured. */
+	2,
+	"CyanogenMod's DSP Chain",
+	"Antti S. Lankila"
+};
 
 struct effect_module_s {
 	const struct effect_interface_s *itfe;
 	Effect *effect;
-	effect_descriptor_t *descriptor;
+	const effect_descriptor_t *descriptor;
+	/* Hands the module back to the pool it came from */
+	void (*release)(struct effect_module_s *module);
 };
 
 static int32_t generic_process(effect_handle_t self, audio_buffer_t *in, audio_buffer_t *out) {
 	struct effect_module_s *e = (struct effect_module_s *) self;
-	return e->effect->process(in, out);
+	return e->effect->processBuffer(in, out);
 }
 
 static int32_t generic_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize, void *pCmdData, uint32_t *replySize, void *pReplyData) {
 	struct effect_module_s *e = (struct effect_module_s *) self;
-	return e->effect->command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+	return e->effect->handleCommand(cmdCode, cmdSize, pCmdData, replySize, pReplyData, e->descriptor->name);
 }
 
 static int32_t generic_getDescriptor(effect_handle_t self, effect_descriptor_t *pDescriptor) {
@@ -109,69 +133,127 @@ static const struct effect_interface_s generic_interface = {
 	NULL
 };
 
-int32_t EffectCreate(const effect_uuid_t *uuid, int32_t __attribute__((unused))sessionId, int32_t __attribute__((unused))ioId, effect_handle_t *pEffect) {
-	if (memcmp(uuid, &compression_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		struct effect_module_s *e = (struct effect_module_s *) calloc(1, sizeof(struct effect_module_s));
-		e->itfe = &generic_interface;
-		e->effect = new EffectCompression();
-		e->descriptor = &compression_descriptor;
-		*pEffect = (effect_handle_t) e;
-		return 0;
+/* A module and its effect in one pooled block. The handle is the module
+ * at the start of the block; the effect gets a cache line of its own. */
+template <typename T>
+struct EffectModule {
+	struct effect_module_s module;
+	alignas(EFFECT_POOL_ALIGNMENT) T effect;
+
+	void recycle() {
+		effect.recycle();
+	}
+};
+
+template <typename T>
+static EffectPool<EffectModule<T> >& effectPool() {
+	static EffectPool<EffectModule<T> > pool;
+	return pool;
+}
+
+template <typename T>
+static void releaseModule(struct effect_module_s *module) {
+	effectPool<T>().release((EffectModule<T> *) module);
+}
+
+template <typename T>
+static int32_t createModule(const effect_descriptor_t *descriptor, effect_handle_t *pEffect) {
+	EffectModule<T> *m = effectPool<T>().acquire();
+	if (m == NULL) {
+		return -ENOMEM;
 	}
-	if (memcmp(uuid, &equalizer_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		struct effect_module_s *e = (struct effect_module_s *) calloc(1, sizeof(struct effect_module_s));
-		e->itfe = &generic_interface;
-		e->effect = new EffectEqualizer();
-		e->descriptor = &equalizer_descriptor;
-		*pEffect = (effect_handle_t) e;
-		return 0;
+	m->module.itfe = &generic_interface;
+	m->module.effect = &m->effect;
+	m->module.descriptor = descriptor;
+	m->module.release = releaseModule<T>;
+	*pEffect = (effect_handle_t) &m->module;
+	return 0;
+}
+
+struct effect_entry_s {
+	const effect_descriptor_t *descriptor;
+	int32_t (*create)(const effect_descriptor_t *descriptor, effect_handle_t *pEffect);
+};
+
+/* Every effect of the library, one line each. */
+static constexpr struct effect_entry_s effects[] = {
+	{ &compression_descriptor, createModule<EffectCompression> },
+	{ &bassboost_descriptor, createModule<EffectBassBoost> },
+	{ &equalizer_descriptor, createModule<EffectEqualizer> },
+	{ &virtualizer_descriptor, createModule<EffectVirtualizer> },
+	{ &limiter_descriptor, createModule<EffectLimiter> },
+	{ &chain_descriptor, createModule<EffectChain> },
+};
+
+#define EFFECT_COUNT int32_t(sizeof(effects) / sizeof(effects[0]))
+
+/* Open addressed index from UUID hash to effects[], built at compile
+ * time. A power of two, kept under half full. */
+#define EFFECT_INDEX_BITS 4
+#define EFFECT_INDEX_SIZE (1 << EFFECT_INDEX_BITS)
+
+static_assert(EFFECT_COUNT * 2 <= EFFECT_INDEX_SIZE, "grow EFFECT_INDEX_BITS");
+
+struct effect_index_s {
+	int8_t entry[EFFECT_INDEX_SIZE];
+};
+
+/* timeLow alone is random in both v4 and v5 UUIDs. */
+static constexpr uint32_t uuidSlot(const effect_uuid_t &uuid) {
+	return (uuid.timeLow * 2654435761u) >> (32 - EFFECT_INDEX_BITS);
+}
+
+static constexpr struct effect_index_s buildIndex() {
+	struct effect_index_s index = {};
+	for (int32_t i = 0; i < EFFECT_INDEX_SIZE; i ++) {
+		index.entry[i] = -1;
 	}
-	if (memcmp(uuid, &virtualizer_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		struct effect_module_s *e = (struct effect_module_s *) calloc(1, sizeof(struct effect_module_s));
-		e->itfe = &generic_interface;
-		e->effect = new EffectVirtualizer();
-		e->descriptor = &virtualizer_descriptor;
-		*pEffect = (effect_handle_t) e;
-		return 0;
+	for (int32_t i = 0; i < EFFECT_COUNT; i ++) {
+		uint32_t slot = uuidSlot(effects[i].descriptor->uuid);
+		while (index.entry[slot] >= 0) {
+			slot = (slot + 1) & (EFFECT_INDEX_SIZE - 1);
+		}
+		index.entry[slot] = i;
 	}
-	if (memcmp(uuid, &bassboost_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		struct effect_module_s *e = (struct effect_module_s *) calloc(1, sizeof(struct effect_module_s));
-		e->itfe = &generic_interface;
-		e->effect = new EffectBassBoost();
-		e->descriptor = &bassboost_descriptor;
-		*pEffect = (effect_handle_t) e;
-		return 0;
+	return index;
+}
+
+static constexpr struct effect_index_s effectIndex = buildIndex();
+
+static const struct effect_entry_s *findEffect(const effect_uuid_t *uuid) {
+	for (uint32_t slot = uuidSlot(*uuid); effectIndex.entry[slot] >= 0; slot = (slot + 1) & (EFFECT_INDEX_SIZE - 1)) {
+		const struct effect_entry_s *entry = &effects[effectIndex.entry[slot]];
+		if (memcmp(uuid, &entry->descriptor->uuid, sizeof(effect_uuid_t)) == 0) {
+			return entry;
+		}
 	}
+	return NULL;
+}
+
+/* Library mandatory methods. */
+extern "C" {
 
-	return -EINVAL;
+int32_t EffectCreate(const effect_uuid_t *uuid, int32_t __attribute__((unused))sessionId, int32_t __attribute__((unused))ioId, effect_handle_t *pEffect) {
+	const struct effect_entry_s *entry = findEffect(uuid);
+	if (entry == NULL) {
+		return -EINVAL;
+	}
+	return entry->create(entry->descriptor, pEffect);
 }
 
 int32_t EffectRelease(effect_handle_t ei) {
 	struct effect_module_s *e = (struct effect_module_s *) ei;
-	delete e->effect;
-	free(e);
+	e->release(e);
 	return 0;
 }
 
 int32_t EffectGetDescriptor(const effect_uuid_t *uuid, effect_descriptor_t *pDescriptor) {
-	if (memcmp(uuid, &compression_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		memcpy(pDescriptor, &compression_descriptor, sizeof(effect_descriptor_t));
-		return 0;
-	}
-	if (memcmp(uuid, &bassboost_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		memcpy(pDescriptor, &bassboost_descriptor, sizeof(effect_descriptor_t));
-		return 0;
-	}
-	if (memcmp(uuid, &equalizer_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		memcpy(pDescriptor, &equalizer_descriptor, sizeof(effect_descriptor_t));
-		return 0;
+	const struct effect_entry_s *entry = findEffect(uuid);
+	if (entry == NULL) {
+		return -EINVAL;
 	}
-	if (memcmp(uuid, &virtualizer_descriptor.uuid, sizeof(effect_uuid_t)) == 0) {
-		memcpy(pDescriptor, &virtualizer_descriptor, sizeof(effect_descriptor_t));
-		return 0;
-	}
-
-	return -EINVAL;
+	memcpy(pDescriptor, entry->descriptor, sizeof(effect_descriptor_t));
+	return 0;
 }
 
 audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM = {